@@ -0,0 +1,151 @@
+/*
+ * This file is part of Usbpp, a C++ wrapper around libusb
+ * Copyright (C) 2016  Lukas Jirkovsky <l.jirkovsky @at@ gmail.com>
+ *
+ * Usbpp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, version 3 of the License
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Measures the number of completed bulk-in transfers per second for an
+ * increasing number of event loop threads.
+ *
+ * Every endpoint given on the command line is kept busy with a number
+ * of transfers which are resubmitted from the completion callback.
+ * The callback optionally simulates processing of the received data
+ * by spinning for the given number of microseconds.
+ */
+
+#include "buffer.h"
+#include "context.h"
+#include "device.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <libusb.h>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace {
+
+const std::size_t TRANSFER_SIZE = 16384;
+const std::size_t TRANSFERS_PER_ENDPOINT = 8;
+
+std::atomic<bool> running(false);
+std::atomic<unsigned long> completions(0);
+std::atomic<int> inflight(0);
+std::chrono::microseconds work(0);
+
+struct Stream {
+	Usbpp::Device device;
+	unsigned char endpoint;
+	std::vector<Usbpp::ByteBuffer> buffers;
+};
+
+void submit(Stream& stream, std::size_t i) {
+	stream.device.bulkTransferInAsync(stream.endpoint, stream.buffers[i], 1000, [&stream, i](int error, int) {
+		if (error == 0) {
+			++completions;
+		}
+		// simulate processing of the data
+		std::chrono::steady_clock::time_point end(std::chrono::steady_clock::now() + work);
+		while (std::chrono::steady_clock::now() < end) {
+		}
+
+		if (running && (error == 0 || error == LIBUSB_ERROR_TIMEOUT)) {
+			try {
+				submit(stream, i);
+				return;
+			}
+			catch (const Usbpp::Exception& e) {
+				std::cerr << e.getDescription() << std::endl;
+			}
+		}
+		--inflight;
+	});
+}
+
+}
+
+int main(int argc, char* argv[]) try {
+	if (argc < 5) {
+		std::cerr << "Wrong arguments!" << std::endl;
+		std::cerr << "\tuse seconds maxthreads work_us vendor:product:interface:endpoint..." << std::endl;
+		std::cerr << "\twhere vendor, product, interface and endpoint are hexadecimal numbers" << std::endl;
+		return 1;
+	}
+	int seconds(std::atoi(argv[1]));
+	unsigned int maxThreads(std::atoi(argv[2]));
+	work = std::chrono::microseconds(std::atoi(argv[3]));
+
+	Usbpp::Context context;
+	std::vector<std::unique_ptr<Stream>> streams;
+	for (int arg = 4; arg < argc; ++arg) {
+		unsigned int vendor, product, interface, endpoint;
+		if (sscanf(argv[arg], "%x:%x:%x:%x", &vendor, &product, &interface, &endpoint) != 4) {
+			std::cerr << "Wrong endpoint " << argv[arg] << std::endl;
+			return 1;
+		}
+		std::vector<Usbpp::Device> devices(context.findDevices(vendor, product));
+		if (devices.empty()) {
+			std::cerr << "No device found for " << argv[arg] << std::endl;
+			return 1;
+		}
+
+		std::unique_ptr<Stream> stream(new Stream);
+		stream->device = devices[0];
+		stream->device.open(true);
+		stream->device.claimInterface(interface);
+		stream->endpoint = endpoint | LIBUSB_ENDPOINT_IN;
+		for (std::size_t i = 0; i < TRANSFERS_PER_ENDPOINT; ++i) {
+			stream->buffers.push_back(Usbpp::ByteBuffer(TRANSFER_SIZE));
+		}
+		streams.push_back(std::move(stream));
+	}
+
+	std::cout << "threads\tcompletions/s" << std::endl;
+	for (unsigned int threads = 1; threads <= maxThreads; ++threads) {
+		context.setEventThreadCount(threads);
+		context.startEventLoop();
+
+		completions = 0;
+		running = true;
+		for (std::unique_ptr<Stream>& stream : streams) {
+			for (std::size_t i = 0; i < stream->buffers.size(); ++i) {
+				++inflight;
+				submit(*stream, i);
+			}
+		}
+		std::chrono::steady_clock::time_point start(std::chrono::steady_clock::now());
+		std::this_thread::sleep_for(std::chrono::seconds(seconds));
+		unsigned long count(completions);
+		std::chrono::duration<double> elapsed(std::chrono::steady_clock::now() - start);
+
+		running = false;
+		while (inflight > 0) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		}
+		context.stopEventLoop();
+
+		std::cout << threads << "\t" << static_cast<unsigned long>(count / elapsed.count()) << std::endl;
+	}
+
+	return 0;
+}
+catch (const Usbpp::Exception& e) {
+	std::cerr << e.getDescription() << std::endl;
+	return 1;
+}
@@ -0,0 +1,175 @@
+/*
+ * This file is part of Usbpp, a C++ wrapper around libusb
+ * Copyright (C) 2016  Lukas Jirkovsky <l.jirkovsky @at@ gmail.com>
+ *
+ * Usbpp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, version 3 of the License
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Compares the speed of decoding HID input reports using naive per-bit
+ * extraction, per-field word extraction (ReportLayout::extract()) and
+ * the compiled decoder (ReportLayout::decode()).
+ *
+ * The report layout is synthetic: a mix of single-bit buttons, unaligned
+ * axes of various widths and byte-aligned fields, as found in gamepads
+ * and other complex HID devices.
+ */
+
+#include "buffer.h"
+#include "bufferview.h"
+#include "hidlayout.h"
+#include "hidreport.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <vector>
+
+namespace {
+
+/**
+ * Append a short item with a 1 or 2 byte payload.
+ */
+void item(std::vector<std::uint8_t>& descriptor, std::uint8_t prefix, int value) {
+	if (value >= -128 && value <= 127) {
+		descriptor.push_back(prefix | 0x1);
+		descriptor.push_back(value & 0xFF);
+	}
+	else {
+		descriptor.push_back(prefix | 0x2);
+		descriptor.push_back(value & 0xFF);
+		descriptor.push_back((value >> 8) & 0xFF);
+	}
+}
+
+/**
+ * Append an Input main item with \a count fields of \a size bits.
+ */
+void input(std::vector<std::uint8_t>& descriptor, int usage, int count, int size, int minimum, int maximum) {
+	item(descriptor, 0x18, usage); // Usage Minimum
+	item(descriptor, 0x28, usage + count - 1); // Usage Maximum
+	item(descriptor, 0x14, minimum); // Logical Minimum
+	item(descriptor, 0x24, maximum); // Logical Maximum
+	item(descriptor, 0x74, size); // Report Size
+	item(descriptor, 0x94, count); // Report Count
+	item(descriptor, 0x80, 0x02); // Input (Data, Variable, Absolute)
+}
+
+std::vector<std::uint8_t> makeDescriptor() {
+	std::vector<std::uint8_t> descriptor;
+	item(descriptor, 0x04, 0x01); // Usage Page (Generic Desktop)
+	item(descriptor, 0x08, 0x05); // Usage (Game Pad)
+	item(descriptor, 0xA0, 0x01); // Collection (Application)
+	item(descriptor, 0x84, 0x01); // Report ID
+	input(descriptor, 0x01, 13, 1, 0, 1); // buttons
+	input(descriptor, 0x30, 4, 10, -512, 511); // axes
+	input(descriptor, 0x39, 2, 4, 0, 7); // hat switches
+	input(descriptor, 0x40, 6, 12, -2048, 2047); // motion sensors
+	input(descriptor, 0x50, 4, 8, 0, 255); // triggers
+	input(descriptor, 0x60, 2, 16, -32768, 32767); // aligned 16-bit axes
+	input(descriptor, 0x70, 16, 3, -4, 3); // small signed values
+	input(descriptor, 0x80, 8, 7, 0, 127); // odd-sized values
+	descriptor.push_back(0xC0); // End Collection
+	return descriptor;
+}
+
+/**
+ * Extract a field bit by bit.
+ */
+std::int32_t naiveExtract(const std::uint8_t* report, const Usbpp::HID::ReportField& field) {
+	std::uint32_t value(0);
+	for (unsigned int bit = 0; bit < field.bitSize; bit++) {
+		std::uint32_t position(field.bitOffset + bit);
+		value |= ((report[position / 8] >> (position % 8)) & 1u) << bit;
+	}
+	if (field.isSigned && field.bitSize < 32 && (value & (1u << (field.bitSize - 1))) != 0) {
+		value |= ~((1u << field.bitSize) - 1);
+	}
+	return static_cast<std::int32_t>(value);
+}
+
+template<typename F>
+double measure(const char* name, std::size_t iterations, std::int64_t& checksum, F function) {
+	checksum = 0;
+	std::chrono::steady_clock::time_point start(std::chrono::steady_clock::now());
+	for (std::size_t i = 0; i < iterations; i++) {
+		checksum += function(i);
+	}
+	std::chrono::duration<double, std::nano> elapsed(std::chrono::steady_clock::now() - start);
+	double perReport(elapsed.count() / iterations);
+	std::cout << name << "\t" << perReport << " ns/report" << std::endl;
+	return perReport;
+}
+
+}
+
+int main(int argc, char* argv[]) {
+	std::size_t iterations(argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1000000);
+
+	std::vector<std::uint8_t> descriptor(makeDescriptor());
+	Usbpp::HID::ReportTree tree(Usbpp::ByteBuffer(descriptor.data(), descriptor.size()));
+	Usbpp::HID::ReportLayout layout(tree);
+	const std::vector<Usbpp::HID::ReportField>& fields(layout.getFields(1));
+	std::size_t length(layout.getReportLength(1));
+	std::cout << fields.size() << " fields, " << length << " bytes per report, "
+	          << (Usbpp::HID::ReportLayout::isVectorized() ? "AVX2" : "scalar") << " decoder" << std::endl;
+
+	// a set of random reports
+	const std::size_t reportCount = 256;
+	std::mt19937 random(42);
+	std::vector<Usbpp::ByteBuffer> reports;
+	for (std::size_t i = 0; i < reportCount; i++) {
+		Usbpp::ByteBuffer report(length);
+		for (std::size_t j = 0; j < length; j++) {
+			report[j] = random() & 0xFF;
+		}
+		report[0] = 1;
+		reports.push_back(std::move(report));
+	}
+
+	std::vector<std::int32_t> values(fields.size());
+	std::int64_t naiveSum, extractSum, decodeSum;
+	double naive(measure("per-bit", iterations, naiveSum, [&](std::size_t i) {
+		const Usbpp::ByteBuffer& report(reports[i % reportCount]);
+		std::int64_t sum(0);
+		for (const Usbpp::HID::ReportField& field : fields) {
+			sum += naiveExtract(report.data(), field);
+		}
+		return sum;
+	}));
+	measure("per-field", iterations, extractSum, [&](std::size_t i) {
+		const Usbpp::ByteBuffer& report(reports[i % reportCount]);
+		std::int64_t sum(0);
+		for (const Usbpp::HID::ReportField& field : fields) {
+			sum += Usbpp::HID::ReportLayout::extract(report, field);
+		}
+		return sum;
+	});
+	double decode(measure("decode", iterations, decodeSum, [&](std::size_t i) {
+		layout.decode(reports[i % reportCount], values);
+		std::int64_t sum(0);
+		for (std::int32_t value : values) {
+			sum += value;
+		}
+		return sum;
+	}));
+
+	if (naiveSum != extractSum || naiveSum != decodeSum) {
+		std::cerr << "The decoded values differ!" << std::endl;
+		return 1;
+	}
+	std::cout << "speedup of decode over per-bit: " << naive / decode << "x" << std::endl;
+	return 0;
+}
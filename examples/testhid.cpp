@@ -136,22 +136,16 @@ int main(int argc, char* argv[]) try {
 	}
 
 	Usbpp::Context context;
-	std::vector<Usbpp::Device> devices(context.getDevices());
+	std::vector<Usbpp::Device> devices(context.findDevices(vendor, product));
 
 	Usbpp::HID::HIDDevice device;
 	bool found = false;
 	for (Usbpp::Device dev : devices) {
 		try {
 			dev.open(true);
-			libusb_device_descriptor descr(dev.getDescriptor());
-			if (descr.idVendor == vendor && descr.idProduct == product) {
-				device = dev;
-				found = true;
-				break;
-			}
-			else {
-				dev.close();
-			}
+			device = dev;
+			found = true;
+			break;
 		}
 		catch (const Usbpp::Exception& e) {
 			// just silently ignore the exception and try the next device
@@ -0,0 +1,165 @@
+/*
+ * This file is part of Usbpp, a C++ wrapper around libusb
+ * Copyright (C) 2016  Lukas Jirkovsky <l.jirkovsky @at@ gmail.com>
+ *
+ * Usbpp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, version 3 of the License
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBUSBPP_AUTOTUNER_H_
+#define LIBUSBPP_AUTOTUNER_H_
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace Usbpp {
+
+class StreamReader;
+class StreamWriter;
+
+/**
+ * Options of the AutoTuner.
+ */
+struct AutoTunerOptions {
+	/**
+	 * Constructs the default options.
+	 *
+	 * By default, transfer sizes between 4 KiB and 1 MiB are tried, each
+	 * configuration is measured for 500 ms after 100 ms of settling.
+	 */
+	AutoTunerOptions();
+
+	/**
+	 * The smallest transfer size tried.
+	 *
+	 * All the sizes tried are rounded down to a multiple of 1024 bytes, so that
+	 * they are a multiple of the maximum packet size of the endpoint.
+	 */
+	std::size_t minTransferSize;
+	/** The largest transfer size tried, limited by the reader's transfer size. */
+	std::size_t maxTransferSize;
+	/** The transfer size to start from, 0 for the current size of the stream. */
+	std::size_t initialTransferSize;
+	/** The queue depth to start from, 0 for the current depth of the stream. */
+	unsigned int initialDepth;
+	/** Time to let the stream settle after a change before measuring. */
+	std::chrono::milliseconds settleTime;
+	/** Duration of a single measurement. */
+	std::chrono::milliseconds measureTime;
+	/** Relative improvement of the score needed to accept a change. */
+	double threshold;
+	/**
+	 * Relative loss of throughput that is accepted in exchange for a lower
+	 * CPU cost.
+	 */
+	double throughputTolerance;
+};
+
+/**
+ * Result of a single measurement of the AutoTuner.
+ */
+struct AutoTunerMeasurement {
+	/// the measured transfer size
+	std::size_t transferSize;
+	/// the measured queue depth
+	unsigned int depth;
+	/// bytes transferred per second
+	double throughput;
+	/// CPU time of the process spent per second
+	double cpuLoad;
+};
+
+/**
+ * Tunes the transfer size and queue depth of a streaming reader or writer.
+ *
+ * The tuner runs in its own thread while the stream is running. It measures
+ * the throughput and the CPU time of the whole process (which includes the
+ * event loop handling the transfers) for the current configuration and
+ * for its neighbours (the transfer size doubled and halved, the depth
+ * increased and decreased), and moves to the neighbour that transfers the most
+ * bytes per CPU second while keeping the throughput within the tolerance of
+ * the best throughput seen. When no neighbour is better, the tuner has
+ * converged and stops, leaving the best configuration applied.
+ *
+ * The chosen parameters can be read using getTransferSize() and getDepth()
+ * and passed directly to the stream next time, or pinned using pin().
+ */
+class AutoTuner {
+public:
+	/**
+	 * Create a tuner for a reader.
+	 *
+	 * The current transfer size and queue depth of the reader are the largest
+	 * values tried.
+	 *
+	 * \param reader the reader, it must outlive the tuner
+	 * \param options tuning options
+	 */
+	explicit AutoTuner(StreamReader& reader, const AutoTunerOptions& options = AutoTunerOptions());
+	/**
+	 * Create a tuner for a writer.
+	 *
+	 * The current queue depth of the writer is the largest depth tried.
+	 *
+	 * \param writer the writer, it must outlive the tuner
+	 * \param options tuning options
+	 */
+	explicit AutoTuner(StreamWriter& writer, const AutoTunerOptions& options = AutoTunerOptions());
+	AutoTuner(const AutoTuner& other) = delete;
+	/**
+	 * Stops the tuning.
+	 */
+	~AutoTuner();
+
+	AutoTuner& operator=(const AutoTuner& other) = delete;
+
+	/**
+	 * Start tuning in a separate thread.
+	 *
+	 * The stream should be running already.
+	 */
+	void start();
+	/**
+	 * Stop tuning and apply the best configuration found so far.
+	 */
+	void stop();
+	/**
+	 * Stop tuning and apply the given configuration.
+	 */
+	void pin(std::size_t transferSize, unsigned int depth);
+	/**
+	 * Check whether the tuning has converged.
+	 */
+	bool isConverged() const;
+	/**
+	 * Get the best transfer size found so far.
+	 */
+	std::size_t getTransferSize() const;
+	/**
+	 * Get the best queue depth found so far.
+	 */
+	unsigned int getDepth() const;
+	/**
+	 * Get the measurement of the best configuration found so far.
+	 */
+	AutoTunerMeasurement getBest() const;
+
+private:
+	class Impl;
+	std::unique_ptr<Impl> pimpl;
+};
+
+}
+
+#endif
@@ -0,0 +1,336 @@
+/*
+ * This file is part of Usbpp, a C++ wrapper around libusb
+ * Copyright (C) 2016  Lukas Jirkovsky <l.jirkovsky @at@ gmail.com>
+ *
+ * Usbpp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, version 3 of the License
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBUSBPP_AWAITABLE_H_
+#define LIBUSBPP_AWAITABLE_H_
+
+#ifndef USBPP_COROUTINES
+#error "The coroutine support requires C++20 and USBPP_COROUTINES to be defined"
+#endif
+
+#include <coroutine>
+#include <exception>
+#include <functional>
+#include <optional>
+#include <utility>
+
+#include "device.h"
+
+namespace Usbpp {
+
+/**
+ * An awaitable asynchronous transfer.
+ *
+ * The transfer is submitted when the awaiting coroutine is suspended and the
+ * coroutine is resumed from the event loop of the context when the transfer
+ * finishes, see Context::startEventLoop(). The result of co_await is the number
+ * of bytes actually transferred. When the transfer fails, DeviceTransferException
+ * is thrown from co_await, just like from the synchronous transfers.
+ *
+ * The awaitables are created by the Device functions, e.g. Device::bulkIn().
+ */
+class TransferAwaitable {
+public:
+	/**
+	 * Construct an awaitable transfer.
+	 *
+	 * \param submit function submitting the asynchronous transfer with the given callback
+	 */
+	explicit TransferAwaitable(std::function<void(const TransferCallback&)> submit) :
+		m_submit(std::move(submit)),
+		m_error(0),
+		m_transferred(0) {
+
+	}
+
+	bool await_ready() const noexcept {
+		return false;
+	}
+
+	void await_suspend(std::coroutine_handle<> handle) {
+		// the coroutine may be resumed (and this awaitable destroyed) even before
+		// the submit function returns, so do not touch any member afterwards
+		std::function<void(const TransferCallback&)> submit(std::move(m_submit));
+		submit([this, handle](int error, int transferred) {
+			m_error = error;
+			m_transferred = transferred;
+			handle.resume();
+		});
+	}
+
+	int await_resume() const {
+		if (m_error != 0) {
+			throw DeviceTransferException(m_error);
+		}
+		return m_transferred;
+	}
+
+private:
+	std::function<void(const TransferCallback&)> m_submit;
+	int m_error;
+	int m_transferred;
+};
+
+template <typename T>
+class Task;
+
+namespace Detail {
+
+/**
+ * The part of the Task promise shared by all result types.
+ */
+class TaskPromiseBase {
+public:
+	/**
+	 * Resumes the awaiting coroutine when the task finishes.
+	 */
+	class FinalAwaiter {
+	public:
+		bool await_ready() const noexcept {
+			return false;
+		}
+
+		template <typename Promise>
+		std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept {
+			TaskPromiseBase& promise(handle.promise());
+			if (promise.m_detached) {
+				if (promise.m_exception) {
+					// there is nobody to rethrow the exception to
+					std::terminate();
+				}
+				handle.destroy();
+				return std::noop_coroutine();
+			}
+			if (promise.m_continuation) {
+				return promise.m_continuation;
+			}
+			return std::noop_coroutine();
+		}
+
+		void await_resume() const noexcept {
+
+		}
+	};
+
+	TaskPromiseBase() : m_detached(false) {
+
+	}
+
+	std::suspend_always initial_suspend() const noexcept {
+		return std::suspend_always();
+	}
+
+	FinalAwaiter final_suspend() const noexcept {
+		return FinalAwaiter();
+	}
+
+	void unhandled_exception() noexcept {
+		m_exception = std::current_exception();
+	}
+
+	std::coroutine_handle<> m_continuation;
+	std::exception_ptr m_exception;
+	bool m_detached;
+};
+
+template <typename T>
+class TaskPromise : public TaskPromiseBase {
+public:
+	Task<T> get_return_object() noexcept;
+
+	template <typename U>
+	void return_value(U&& value) {
+		m_value.emplace(std::forward<U>(value));
+	}
+
+	T result() {
+		if (m_exception) {
+			std::rethrow_exception(m_exception);
+		}
+		return std::move(*m_value);
+	}
+
+private:
+	std::optional<T> m_value;
+};
+
+template <>
+class TaskPromise<void> : public TaskPromiseBase {
+public:
+	Task<void> get_return_object() noexcept;
+
+	void return_void() noexcept {
+
+	}
+
+	void result() {
+		if (m_exception) {
+			std::rethrow_exception(m_exception);
+		}
+	}
+};
+
+}
+
+/**
+ * A lazily started coroutine.
+ *
+ * The coroutine starts running when the task is awaited by another coroutine
+ * using co_await, which then evaluates to the value returned by the task
+ * (or rethrows the exception thrown by the task). The top-level task can be
+ * started using detach(), in which case it runs on its own until it finishes.
+ *
+ * The coroutine frame holds only the parameters of the coroutine. Whatever
+ * they refer to (including the object of a member coroutine) must outlive
+ * the task, which for a detached task means until it finishes.
+ *
+ * Together with the awaitable transfers (see Device::bulkIn() and others),
+ * the tasks allow writing sequential protocol code that does not block
+ * any thread while waiting for the device, so many devices can be served
+ * by the few threads running the event loop.
+ */
+template <typename T = void>
+class Task {
+public:
+	using promise_type = Detail::TaskPromise<T>;
+
+	Task() noexcept {
+
+	}
+
+	Task(const Task& other) = delete;
+
+	Task(Task&& other) noexcept : m_handle(std::exchange(other.m_handle, nullptr)) {
+
+	}
+
+	~Task() {
+		if (m_handle) {
+			m_handle.destroy();
+		}
+	}
+
+	Task& operator=(const Task& other) = delete;
+
+	Task& operator=(Task&& other) noexcept {
+		if (this != &other) {
+			if (m_handle) {
+				m_handle.destroy();
+			}
+			m_handle = std::exchange(other.m_handle, nullptr);
+		}
+		return *this;
+	}
+
+	/**
+	 * Start the task and let it run on its own.
+	 *
+	 * The coroutine frame is destroyed when the task finishes. The task must not
+	 * finish with an exception, there is nobody to handle it (std::terminate()
+	 * is called in that case).
+	 */
+	void detach() {
+		std::coroutine_handle<promise_type> handle(std::exchange(m_handle, nullptr));
+		handle.promise().m_detached = true;
+		handle.resume();
+	}
+
+	bool await_ready() const noexcept {
+		return false;
+	}
+
+	std::coroutine_handle<> await_suspend(std::coroutine_handle<> continuation) noexcept {
+		m_handle.promise().m_continuation = continuation;
+		return m_handle;
+	}
+
+	T await_resume() {
+		return m_handle.promise().result();
+	}
+
+private:
+	friend class Detail::TaskPromise<T>;
+
+	explicit Task(std::coroutine_handle<promise_type> handle) noexcept : m_handle(handle) {
+
+	}
+
+	std::coroutine_handle<promise_type> m_handle;
+};
+
+namespace Detail {
+
+template <typename T>
+inline Task<T> TaskPromise<T>::get_return_object() noexcept {
+	return Task<T>(std::coroutine_handle<TaskPromise<T>>::from_promise(*this));
+}
+
+inline Task<void> TaskPromise<void>::get_return_object() noexcept {
+	return Task<void>(std::coroutine_handle<TaskPromise<void>>::from_promise(*this));
+}
+
+}
+
+inline TransferAwaitable Device::controlIn(uint8_t bmRequestType,
+                                           uint8_t bRequest,
+                                           uint16_t wValue,
+                                           uint16_t wIndex,
+                                           ByteBuffer& data,
+                                           unsigned int timeout) const {
+	return TransferAwaitable([=, this, &data](const TransferCallback& callback) {
+		controlTransferInAsync(bmRequestType, bRequest, wValue, wIndex, data, timeout, callback);
+	});
+}
+
+inline TransferAwaitable Device::controlOut(uint8_t bmRequestType,
+                                            uint8_t bRequest,
+                                            uint16_t wValue,
+                                            uint16_t wIndex,
+                                            const ByteBuffer& data,
+                                            unsigned int timeout) const {
+	return TransferAwaitable([=, this, &data](const TransferCallback& callback) {
+		controlTransferOutAsync(bmRequestType, bRequest, wValue, wIndex, data, timeout, callback);
+	});
+}
+
+inline TransferAwaitable Device::bulkIn(unsigned char endpoint, ByteBuffer& data, unsigned int timeout) const {
+	return TransferAwaitable([=, this, &data](const TransferCallback& callback) {
+		bulkTransferInAsync(endpoint, data, timeout, callback);
+	});
+}
+
+inline TransferAwaitable Device::bulkOut(unsigned char endpoint, const ByteBuffer& data, unsigned int timeout) const {
+	return TransferAwaitable([=, this, &data](const TransferCallback& callback) {
+		bulkTransferOutAsync(endpoint, data, timeout, callback);
+	});
+}
+
+inline TransferAwaitable Device::interruptIn(unsigned char endpoint, ByteBuffer& data, unsigned int timeout) const {
+	return TransferAwaitable([=, this, &data](const TransferCallback& callback) {
+		interruptTransferInAsync(endpoint, data, timeout, callback);
+	});
+}
+
+inline TransferAwaitable Device::interruptOut(unsigned char endpoint, const ByteBuffer& data, unsigned int timeout) const {
+	return TransferAwaitable([=, this, &data](const TransferCallback& callback) {
+		interruptTransferOutAsync(endpoint, data, timeout, callback);
+	});
+}
+
+}
+
+#endif
@@ -23,8 +23,26 @@
 
 namespace Usbpp {
 
+class BufferPool;
+
 /**
- * A static-sized buffer.
+ * A byte buffer.
+ *
+ * Buffers of up to InlineSize bytes keep their data inside the object itself,
+ * so that the small buffers used for the commands and descriptors do not
+ * need any heap allocation.
+ *
+ * Like std::vector, the buffer may hold more storage than its size. The storage
+ * grows geometrically, so that building a buffer by repeated append() takes
+ * amortized linear time, and it is never released by shrinking the buffer.
+ *
+ * The heap storage can be drawn from a BufferPool instead of malloc, see
+ * ByteBuffer(std::size_t, BufferPool&). Alternatively, the storage can be
+ * aligned and backed by huge pages, see ByteBuffer(std::size_t, std::size_t, bool).
+ * The allocation policy (the pool, alignment and huge pages) is kept whenever
+ * the storage is reallocated. Copy construction and moves pass the policy
+ * to the new buffer, while copy assignment keeps the policy of the assigned-to
+ * buffer.
  */
 class ByteBuffer {
 public:
@@ -42,6 +60,34 @@ public:
 	 * \param size Size of the buffer.
 	 */
 	explicit ByteBuffer(std::size_t size);
+	/**
+	 * Construct a buffer with a specified size using storage from a pool.
+	 *
+	 * The buffer (and its copies) takes all its heap storage from \a pool,
+	 * including the storage needed when the buffer grows, and returns it
+	 * to the pool when the buffer is destroyed. The pool must outlive
+	 * the buffer. A buffer using a page-aligned pool never uses the inline
+	 * storage. The data are not initialized.
+	 *
+	 * \param size Size of the buffer.
+	 * \param pool The pool to allocate the storage from.
+	 */
+	ByteBuffer(std::size_t size, BufferPool& pool);
+	/**
+	 * Construct an aligned buffer with a specified size.
+	 *
+	 * Such buffers are suitable e.g. for I/O with O_DIRECT. A buffer
+	 * with an alignment stricter than the default one never uses the inline
+	 * storage. The data are not initialized.
+	 *
+	 * \param size Size of the buffer.
+	 * \param alignment Alignment of the storage, a power of two.
+	 * \param hugePages Whether the storage should be backed by huge pages.
+	 *        The storage is then aligned and rounded to HugePageSize and
+	 *        the system is advised to use huge pages for it (on Linux,
+	 *        this requires transparent huge pages to be enabled).
+	 */
+	ByteBuffer(std::size_t size, std::size_t alignment, bool hugePages = false);
 	/**
 	 * Constructs a buffer from existing byte buffer.
 	 *
@@ -93,7 +139,8 @@ public:
 	 * Append another buffer.
 	 *
 	 * The data of \a other buffer are appended at the end of the current buffer
-	 * and the current buffer is resized accordingly.
+	 * and the current buffer is resized accordingly. The storage is reallocated
+	 * only when the capacity is exceeded.
 	 *
 	 * \param other Buffer to append.
 	 * \return The resulting buffer.
@@ -103,10 +150,51 @@ public:
 	/**
 	 * Resize the buffer.
 	 *
+	 * The storage is reallocated only when \a size exceeds the capacity.
+	 * When the buffer grows, the data beyond the previous size are not
+	 * initialized.
+	 *
 	 * \param size New buffer size.
 	 */
 	void resize(std::size_t size);
 
+	/**
+	 * Reserve storage.
+	 *
+	 * Makes sure the buffer can grow up to \a capacity bytes without
+	 * reallocation. The size of the buffer is not changed.
+	 *
+	 * \param capacity Minimal capacity of the buffer.
+	 */
+	void reserve(std::size_t capacity);
+
+	/**
+	 * Release the storage exceeding the buffer size.
+	 */
+	void shrink_to_fit();
+
+	/**
+	 * Get the number of bytes the buffer can hold without reallocation.
+	 */
+	std::size_t capacity() const;
+
+	/**
+	 * Get the pool used to allocate the storage.
+	 *
+	 * \return the pool or nullptr if the storage is allocated using malloc
+	 */
+	BufferPool* getPool() const;
+
+	/**
+	 * Get the alignment of the storage.
+	 */
+	std::size_t getAlignment() const;
+
+	/**
+	 * Whether the storage is backed by huge pages.
+	 */
+	bool getHugePages() const;
+
 	/**
 	 * Get the current buffer size.
 	 */
@@ -124,9 +212,50 @@ public:
 	 */
 	const std::uint8_t* data() const;
 
+	/**
+	 * Size up to which the data are stored inline without heap allocation.
+	 */
+	static const std::size_t InlineSize = 64;
+
+	/**
+	 * Size of the huge pages used by the buffers with the huge page policy.
+	 */
+	static const std::size_t HugePageSize = 2 << 20;
+
 private:
+	/**
+	 * Get storage for \a capacity bytes, either the inline or a heap allocated one.
+	 *
+	 * \param capacity requested capacity on input, the real capacity on output
+	 */
+	std::uint8_t* allocate(std::size_t& capacity);
+	/**
+	 * Move the data to storage of a different capacity.
+	 *
+	 * \param capacity New capacity, must not be lower than the size.
+	 */
+	void reallocate(std::size_t capacity);
+	/**
+	 * Free the storage if it was allocated on the heap.
+	 */
+	void deallocate();
+	/**
+	 * Whether the data are stored inline.
+	 */
+	bool isInline() const;
+	/**
+	 * Get the capacity of the inline storage, 0 if the policy doesn't allow it.
+	 */
+	std::size_t inlineCapacity() const;
+
 	std::uint8_t* m_data;
 	std::size_t m_size;
+	std::size_t m_capacity;
+	BufferPool* m_pool;
+	// 0 for the default alignment
+	std::size_t m_alignment;
+	bool m_hugePages;
+	alignas(std::max_align_t) std::uint8_t m_inline[InlineSize];
 };
 
 }
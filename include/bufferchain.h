@@ -0,0 +1,135 @@
+/*
+ * This file is part of Usbpp, a C++ wrapper around libusb
+ * Copyright (C) 2016  Lukas Jirkovsky <l.jirkovsky @at@ gmail.com>
+ *
+ * Usbpp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, version 3 of the License
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBUSBPP_BUFFERCHAIN_H_
+#define LIBUSBPP_BUFFERCHAIN_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+
+#include "buffer.h"
+#include "bufferview.h"
+#include "sharedbuffer.h"
+
+namespace Usbpp {
+
+/**
+ * A message assembled from a sequence of buffer segments.
+ *
+ * The segments are SharedBuffers, so appending, prepending and splitting
+ * the chain only manipulates the references to the segments and never moves
+ * the data. This allows protocol layers to add headers and trailers around
+ * a payload without copying it. The data are copied into a contiguous buffer
+ * only when linearize() or toBuffer() is called.
+ */
+class BufferChain {
+public:
+	/**
+	 * Construct an empty chain.
+	 */
+	BufferChain();
+	/**
+	 * Construct a chain with a single segment.
+	 */
+	explicit BufferChain(const SharedBuffer& segment);
+	BufferChain(const BufferChain& other);
+	BufferChain(BufferChain&& other) noexcept;
+	~BufferChain();
+
+	BufferChain& operator=(const BufferChain& other);
+	BufferChain& operator=(BufferChain&& other) noexcept;
+
+	/**
+	 * Append a segment at the end of the chain.
+	 *
+	 * Empty segments are ignored.
+	 */
+	BufferChain& append(const SharedBuffer& segment);
+	/**
+	 * Append all segments of another chain at the end of the chain.
+	 */
+	BufferChain& append(const BufferChain& other);
+	/**
+	 * Insert a segment at the beginning of the chain.
+	 *
+	 * Empty segments are ignored.
+	 */
+	BufferChain& prepend(const SharedBuffer& segment);
+	/**
+	 * Insert all segments of another chain at the beginning of the chain.
+	 */
+	BufferChain& prepend(const BufferChain& other);
+
+	/**
+	 * Split the chain.
+	 *
+	 * This chain keeps the first \a offset bytes, the rest is returned.
+	 * A segment crossing the split point is sliced, no data are copied.
+	 *
+	 * \param offset The split point, clipped to the size of the chain.
+	 * \return The chain holding the bytes from \a offset to the end.
+	 */
+	BufferChain split(std::size_t offset);
+
+	/**
+	 * Make the data contiguous.
+	 *
+	 * If the chain has more than one segment, the data are copied to a new
+	 * buffer, which then becomes the only segment.
+	 *
+	 * \return The view of the whole data, valid until the chain is modified.
+	 */
+	ByteBufferView linearize();
+
+	/**
+	 * Copy the data to a new contiguous buffer.
+	 */
+	ByteBuffer toBuffer() const;
+
+	/**
+	 * Remove all segments.
+	 */
+	void clear();
+
+	/**
+	 * Get the total number of bytes in the chain.
+	 */
+	std::size_t size() const;
+	/**
+	 * Whether the chain holds no data.
+	 */
+	bool empty() const;
+	/**
+	 * Get the number of segments.
+	 */
+	std::size_t getSegmentCount() const;
+	/**
+	 * Get a segment.
+	 *
+	 * \param i index of the segment, lower than getSegmentCount()
+	 */
+	const SharedBuffer& getSegment(std::size_t i) const;
+
+private:
+	std::deque<SharedBuffer> m_segments;
+	std::size_t m_size;
+};
+
+}
+
+#endif
@@ -0,0 +1,117 @@
+/*
+ * This file is part of Usbpp, a C++ wrapper around libusb
+ * Copyright (C) 2016  Lukas Jirkovsky <l.jirkovsky @at@ gmail.com>
+ *
+ * Usbpp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, version 3 of the License
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBUSBPP_BUFFERPOOL_H_
+#define LIBUSBPP_BUFFERPOOL_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace Usbpp {
+
+/**
+ * Statistics of a BufferPool.
+ */
+struct BufferPoolStatistics {
+	/// number of blocks handed out by the pool
+	std::uint64_t allocations;
+	/// number of blocks returned to the pool
+	std::uint64_t deallocations;
+	/// number of blocks the pool allocated from the system
+	std::uint64_t systemAllocations;
+	/// number of blocks the pool returned to the system
+	std::uint64_t systemDeallocations;
+};
+
+/**
+ * A pool of memory blocks for the transfer buffers.
+ *
+ * The blocks are grouped into power-of-two size classes from 128 bytes up to
+ * MaxPooledSize. A released block is kept on the free list of its class
+ * and reused by the next allocation of the same class, so that a steady stream
+ * of same-sized buffers does not allocate any memory from the system once
+ * the pool is warmed up. Each thread keeps a small cache of free blocks
+ * per class that is accessed without locking, only the overflow of the cache
+ * goes to the shared free lists. Larger blocks are allocated directly
+ * from the system.
+ *
+ * The pool is used by constructing a ByteBuffer with
+ * ByteBuffer(std::size_t, BufferPool&). The buffer returns its storage
+ * to the pool when it is destroyed. The pool must outlive all the buffers
+ * using it.
+ *
+ * All functions are thread-safe.
+ */
+class BufferPool {
+public:
+	/**
+	 * The largest block size served from the free lists.
+	 */
+	static const std::size_t MaxPooledSize = 4 << 20;
+
+	/**
+	 * Create a pool.
+	 *
+	 * \param pageAligned whether the blocks should be aligned to the page size
+	 */
+	explicit BufferPool(bool pageAligned = false);
+	BufferPool(const BufferPool& other) = delete;
+	~BufferPool();
+
+	BufferPool& operator=(const BufferPool& other) = delete;
+
+	/**
+	 * Allocate a block.
+	 *
+	 * \param size requested size on input, the real usable size of the block
+	 *        on output
+	 * \return the allocated block
+	 * \throw std::bad_alloc if the memory cannot be allocated
+	 */
+	std::uint8_t* allocate(std::size_t& size);
+	/**
+	 * Return a block to the pool.
+	 *
+	 * \param data block returned by allocate()
+	 * \param size the size of the block returned by allocate()
+	 */
+	void deallocate(std::uint8_t* data, std::size_t size);
+
+	/**
+	 * Release the free blocks held by the shared free lists and the cache
+	 * of the calling thread to the system.
+	 */
+	void trim();
+
+	/**
+	 * Get the alignment of the blocks.
+	 */
+	std::size_t getAlignment() const;
+	/**
+	 * Get the statistics.
+	 */
+	BufferPoolStatistics getStatistics() const;
+
+private:
+	class Impl;
+	std::unique_ptr<Impl> pimpl;
+};
+
+}
+
+#endif
@@ -0,0 +1,144 @@
+/*
+ * This file is part of Usbpp, a C++ wrapper around libusb
+ * Copyright (C) 2016  Lukas Jirkovsky <l.jirkovsky @at@ gmail.com>
+ *
+ * Usbpp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, version 3 of the License
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBUSBPP_BUFFERVIEW_H_
+#define LIBUSBPP_BUFFERVIEW_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include "buffer.h"
+
+namespace Usbpp {
+
+/**
+ * A non-owning view of a contiguous range of bytes.
+ *
+ * The view holds just a pointer and a length, so it is cheap to copy
+ * and creating it or slicing it never allocates or copies the data.
+ * The viewed data must outlive the view. A view of a ByteBuffer is
+ * invalidated when the buffer is resized, moved or destroyed.
+ */
+class ByteBufferView {
+public:
+	/**
+	 * Construct an empty view.
+	 */
+	ByteBufferView() : m_data(nullptr), m_size(0) {
+
+	}
+
+	/**
+	 * Construct a view of an array.
+	 *
+	 * \param data The first byte of the array.
+	 * \param size Size of the array in bytes.
+	 */
+	ByteBufferView(const std::uint8_t* data, std::size_t size) : m_data(data), m_size(size) {
+
+	}
+
+	/**
+	 * Construct a view of the whole buffer.
+	 */
+	ByteBufferView(const ByteBuffer& buffer) : m_data(buffer.data()), m_size(buffer.size()) {
+
+	}
+
+	/**
+	 * Byte access operator.
+	 *
+	 * \param i Byte to access.
+	 * \return Reference to \a i-th byte.
+	 */
+	const std::uint8_t& operator[](std::size_t i) const {
+		return m_data[i];
+	}
+
+	/**
+	 * Get a view of a sub-range.
+	 *
+	 * The range is clipped to the bounds of this view.
+	 *
+	 * \param offset Offset of the first byte of the sub-range.
+	 * \param length Maximal length of the sub-range.
+	 * \return The view of the sub-range.
+	 */
+	ByteBufferView slice(std::size_t offset, std::size_t length) const {
+		if (offset >= m_size) {
+			return ByteBufferView();
+		}
+		return ByteBufferView(m_data + offset, length < m_size - offset ? length : m_size - offset);
+	}
+
+	/**
+	 * Get a view of all the bytes starting at \a offset.
+	 */
+	ByteBufferView slice(std::size_t offset) const {
+		return slice(offset, m_size);
+	}
+
+	/**
+	 * Copy the viewed data to a new buffer.
+	 */
+	ByteBuffer toBuffer() const {
+		return ByteBuffer(m_data, m_size);
+	}
+
+	/**
+	 * Get the number of bytes in the view.
+	 */
+	std::size_t size() const {
+		return m_size;
+	}
+
+	/**
+	 * Whether the view is empty.
+	 */
+	bool empty() const {
+		return m_size == 0;
+	}
+
+	/**
+	 * Get pointer to the viewed data.
+	 */
+	const std::uint8_t* data() const {
+		return m_data;
+	}
+
+	/**
+	 * Iterator to the first byte.
+	 */
+	const std::uint8_t* begin() const {
+		return m_data;
+	}
+
+	/**
+	 * Iterator past the last byte.
+	 */
+	const std::uint8_t* end() const {
+		return m_data + m_size;
+	}
+
+private:
+	const std::uint8_t* m_data;
+	std::size_t m_size;
+};
+
+}
+
+#endif
@@ -18,12 +18,16 @@
 #ifndef LIBUSBPP_CONTEXT_H_
 #define LIBUSBPP_CONTEXT_H_
 
+#include <chrono>
+#include <cstdint>
 #include <functional>
 #include <memory>
+#include <string>
 #include <vector>
 
 #include "device.h"
 #include "exception.h"
+#include "probe.h"
 
 namespace Usbpp {
 
@@ -60,6 +64,43 @@ public:
 	virtual const char* what() const noexcept;
 };
 
+/**
+ * An exception thrown when handling of the events fails.
+ */
+class ContextEventException : public Exception {
+public:
+	explicit ContextEventException(int error) noexcept;
+	virtual ~ContextEventException();
+
+	virtual const char* what() const noexcept;
+};
+
+
+/**
+ * A file descriptor the libusb events are signalled on.
+ */
+struct PollFd {
+	/// file descriptor
+	int fd;
+	/// events to wait for, as in the poll() events bitmask (POLLIN, POLLOUT)
+	short events;
+};
+
+/**
+ * Statistics of the busy-poll event loop, see Context::setBusyPoll().
+ */
+struct BusyPollStatistics {
+	/// number of polls of the libusb events
+	std::uint64_t polls;
+	/// number of completed transfers
+	std::uint64_t completions;
+	/// latency between the start of the poll that completed a transfer and its callback
+	std::chrono::nanoseconds minLatency;
+	std::chrono::nanoseconds meanLatency;
+	std::chrono::nanoseconds maxLatency;
+	/// the polling thread runs with the requested SCHED_FIFO priority
+	bool realtime;
+};
 
 /**
  * A context.
@@ -72,6 +113,17 @@ public:
  * is started automatically when a callback function is registered. The event loop
  * runs in a separate thread which exists as long as there are any callback
  * functions registered.
+ *
+ * Optionally, the hotplug events can be coalesced, see setHotplugCoalescing().
+ *
+ * The event loop also handles the completion of transfers. It can be started
+ * explicitly using startEventLoop(), in which case it runs until stopEventLoop()
+ * is called, regardless of the registered callbacks.
+ *
+ * The event loop can run in several threads, see setEventThreadCount().
+ *
+ * Alternatively, the events can be handled by the application's own event
+ * loop, see setExternalEventHandling().
  */
 class Context {
 public:
@@ -108,6 +160,75 @@ public:
 	 */
 	std::vector<Device> getDevices();
 
+	/**
+	 * Find all attached devices with the given vendor and product ID.
+	 *
+	 * The lookup uses an index built from the device descriptors cached by libusb,
+	 * so no device is opened. The index is built by the first lookup, refreshed
+	 * by every call to getDevices() and kept up to date by the event loop while
+	 * any hotplug callback is registered.
+	 *
+	 * \param vendorId the idVendor field of the device descriptor
+	 * \param productId the idProduct field of the device descriptor
+	 * \return list of matching devices
+	 */
+	std::vector<Device> findDevices(uint16_t vendorId, uint16_t productId);
+	/**
+	 * Find a device by its serial number.
+	 *
+	 * Reading the serial number requires opening the device. The serial numbers
+	 * are cached in the index, so each device is opened at most once. Devices
+	 * that don't report any serial number are never opened.
+	 *
+	 * Serial numbers are unique only within a vendor and product ID. If devices
+	 * of different products share the serial number, any of them is returned;
+	 * use findDeviceBySerial(uint16_t, uint16_t, const std::string&) to tell
+	 * them apart.
+	 *
+	 * \param serial the serial number string descriptor
+	 * \return the device or an invalid device if no such device is attached
+	 */
+	Device findDeviceBySerial(const std::string& serial);
+	/**
+	 * Find a device by its vendor ID, product ID and serial number.
+	 *
+	 * Same as findDeviceBySerial(const std::string&), except that only devices
+	 * matching \a vendorId and \a productId are opened to read the serial number.
+	 *
+	 * \param vendorId the idVendor field of the device descriptor
+	 * \param productId the idProduct field of the device descriptor
+	 * \param serial the serial number string descriptor
+	 * \return the device or an invalid device if no such device is attached
+	 */
+	Device findDeviceBySerial(uint16_t vendorId, uint16_t productId, const std::string& serial);
+	/**
+	 * Find a device by its position in the USB topology.
+	 *
+	 * \param bus the bus number, see Device::getBusNumber()
+	 * \param ports the port numbers, see Device::getPortNumbers()
+	 * \return the device or an invalid device if no such device is attached
+	 */
+	Device findDeviceByPath(uint8_t bus, const std::vector<uint8_t>& ports);
+
+	/**
+	 * Probe all attached devices concurrently.
+	 *
+	 * Each device is opened and the steps selected in \a options are performed.
+	 * Up to ProbeOptions::concurrency devices are probed at once, each
+	 * in a separate thread. Failures are reported in the results, they
+	 * don't interrupt probing of the other devices.
+	 *
+	 * \param options probing options
+	 * \param func optional function called with each result as soon as the
+	 *        device has been probed. The calls are serialized, but they are
+	 *        made from the probing threads. If \a func throws, no more devices
+	 *        are probed and the exception is rethrown once the devices being
+	 *        probed are finished.
+	 * \return results in the order of completion
+	 */
+	std::vector<ProbeResult> probeDevices(const ProbeOptions& options,
+	                                      const std::function<void(const ProbeResult&)>& func = nullptr);
+
 	/**
 	 * Register a function that is called when a new device is connected.
 	 *
@@ -140,6 +261,181 @@ public:
 	 */
 	void unregisterDeviceDisconnected(int handle);
 
+	/**
+	 * Register a function that is called with a batch of connected and removed devices.
+	 *
+	 * The function is called asynchronously from a context event loop after
+	 * the callbacks registered for individual devices. Without coalescing,
+	 * it is called for every hotplug event with a single device.
+	 *
+	 * \param func function to call with the connected and the removed devices
+	 * \return handle that can be used in unregisterDevicesChanged()
+	 */
+	int registerDevicesChanged(const std::function<void(const std::vector<Device>& connected,
+	                                                    const std::vector<Device>& disconnected)>& func);
+	/**
+	 * Unregister a batch callback function.
+	 *
+	 * \param handle handle returned by registerDevicesChanged
+	 */
+	void unregisterDevicesChanged(int handle);
+
+	/**
+	 * Set the hotplug event coalescing window.
+	 *
+	 * When the window is non-zero, the hotplug events are collected until no new
+	 * event arrives for \a window milliseconds, but at most for ten times
+	 * the window. The collected events are then delivered at once: the device
+	 * callbacks are called for each event and the batch callbacks are called once.
+	 * A device that arrives and leaves within the same batch is not reported at all.
+	 *
+	 * \param window coalescing window in milliseconds, 0 disables coalescing (default)
+	 */
+	void setHotplugCoalescing(unsigned int window);
+
+	/**
+	 * Start the event loop thread.
+	 *
+	 * The event loop keeps running until stopEventLoop() is called, even when
+	 * there are no callbacks registered.
+	 */
+	void startEventLoop();
+	/**
+	 * Stop the event loop thread started by startEventLoop().
+	 *
+	 * The event loop keeps running as long as there are any callbacks registered.
+	 *
+	 * The function waits for the event loop threads to finish, except when it
+	 * is called from a callback: the calling thread then finishes once
+	 * the callback returns.
+	 */
+	void stopEventLoop();
+	/**
+	 * Set the number of event loop threads.
+	 *
+	 * With more than one thread, the threads take turns in handling the libusb
+	 * events (using libusb_lock_events() and libusb_wait_for_event()), and
+	 * the completion callbacks of the asynchronous transfers are run in
+	 * parallel by the threads that are not handling events at the moment.
+	 * The callbacks of transfers on the same endpoint are still called
+	 * in order, one at a time.
+	 *
+	 * If the event loop is running, it is restarted with the new number of threads.
+	 *
+	 * \param count number of threads, 1 by default
+	 */
+	void setEventThreadCount(unsigned int count);
+	/**
+	 * Pin the event loop threads to CPUs.
+	 *
+	 * The i-th event loop thread is pinned to the CPU \a cpu + i. The setting
+	 * applies to the running event loop threads as well as to any event loop
+	 * threads started later.
+	 *
+	 * \param cpu index of the first CPU or -1 to allow all CPUs
+	 */
+	void setEventLoopAffinity(int cpu);
+	/**
+	 * Enable or disable the busy-poll event loop.
+	 *
+	 * In the busy-poll mode, the event loop runs in a single dedicated thread
+	 * that polls the libusb events with zero timeout in a tight loop instead of
+	 * sleeping until an event arrives. This trades one fully used CPU core for
+	 * the lowest possible latency of the transfer callbacks, which is useful
+	 * mainly for interrupt endpoints. The setEventThreadCount() setting is
+	 * ignored while busy-polling.
+	 *
+	 * If the event loop is running, it is restarted in the new mode.
+	 * The busy-poll mode is disabled by default.
+	 *
+	 * \param enable true to enable the busy-poll mode
+	 * \param cpu CPU to pin the polling thread to or -1 to allow all CPUs
+	 * \param priority SCHED_FIFO priority of the polling thread or 0 to keep
+	 *        the default scheduling policy. Setting the priority usually requires
+	 *        elevated privileges, failure is reported in BusyPollStatistics::realtime.
+	 */
+	void setBusyPoll(bool enable, int cpu = -1, int priority = 0);
+	/**
+	 * Get the statistics of the busy-poll event loop.
+	 *
+	 * The statistics are reset whenever the busy-poll event loop is started.
+	 *
+	 * \return the busy-poll statistics
+	 */
+	BusyPollStatistics getBusyPollStatistics() const;
+
+	/**
+	 * Let the application handle the events instead of the event loop thread.
+	 *
+	 * When enabled, the event loop thread is not started automatically when
+	 * a callback is registered, and the event loop started automatically
+	 * before is stopped. The application is then responsible for waiting on the
+	 * file descriptors returned by getPollFds() (e.g. using epoll) and calling
+	 * handleEventsNonBlocking() whenever any of them becomes ready or when the
+	 * timeout returned by getNextTimeout() expires.
+	 *
+	 * The event loop started explicitly by startEventLoop() is not affected.
+	 *
+	 * \param enable true to handle the events by the application
+	 */
+	void setExternalEventHandling(bool enable);
+	/**
+	 * Get the file descriptors that need to be polled for the libusb events.
+	 *
+	 * The set of the file descriptors may change, for example when a device is
+	 * opened or closed. Use setPollFdNotifiers() to get notified about the changes.
+	 *
+	 * \return list of file descriptors and events to wait for
+	 */
+	std::vector<PollFd> getPollFds() const;
+	/**
+	 * Set the functions called when a file descriptor is added to or removed
+	 * from the set returned by getPollFds().
+	 *
+	 * The functions may be called from any thread that calls into libusb,
+	 * including the threads opening and closing devices.
+	 *
+	 * \param added function called with the file descriptor and the events to wait for
+	 * \param removed function called with the file descriptor
+	 */
+	void setPollFdNotifiers(const std::function<void(int fd, short events)>& added, const std::function<void(int fd)>& removed);
+	/**
+	 * Remove the functions set by setPollFdNotifiers().
+	 */
+	void clearPollFdNotifiers();
+	/**
+	 * Find out whether the timeouts are signalled using the file descriptors.
+	 *
+	 * If true, it is not necessary to use getNextTimeout() as all the timeouts
+	 * are handled once the file descriptors become ready. The expiry of the
+	 * hotplug coalescing window is known only to getNextTimeout(), so this
+	 * always returns false while the coalescing is enabled (see
+	 * setHotplugCoalescing()).
+	 *
+	 * \return true if the timeouts are signalled on the file descriptors
+	 */
+	bool pollFdsHandleTimeouts() const;
+	/**
+	 * Get the time until the nearest libusb timeout expires.
+	 *
+	 * The application should call handleEventsNonBlocking() when the timeout
+	 * expires, even if no file descriptor became ready. The nearest expiry
+	 * of the hotplug coalescing window is included, too.
+	 *
+	 * \param timeout time until the nearest timeout, zero if it has already expired
+	 * \return true if there is a pending timeout, false if \a timeout was not set
+	 */
+	bool getNextTimeout(std::chrono::microseconds& timeout) const;
+	/**
+	 * Handle the pending events without blocking.
+	 *
+	 * Completes the transfers, calls the transfer and hotplug callbacks and
+	 * handles the expired timeouts.
+	 *
+	 * \throws ContextEventException when the events cannot be handled
+	 */
+	void handleEventsNonBlocking();
+
 	// in this case Impl must be public for the hotplug handler to be able to access it
 	class Impl;
 private:
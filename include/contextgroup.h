@@ -0,0 +1,171 @@
+/*
+ * This file is part of Usbpp, a C++ wrapper around libusb
+ * Copyright (C) 2016  Lukas Jirkovsky <l.jirkovsky @at@ gmail.com>
+ *
+ * Usbpp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, version 3 of the License
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBUSBPP_CONTEXTGROUP_H_
+#define LIBUSBPP_CONTEXTGROUP_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "context.h"
+#include "device.h"
+
+namespace Usbpp {
+
+/**
+ * A group of contexts sharing the devices.
+ *
+ * Each context in the group (a shard) has its own libusb context and its
+ * own event loop thread, so the completions of transfers are handled
+ * in parallel. Every device is owned by exactly one shard chosen by a policy.
+ * The devices returned by the group always come from their owning shard,
+ * so their transfers are handled by the event loop of that shard.
+ *
+ * The group provides a unified view of the devices and hotplug events
+ * of all shards.
+ */
+class ContextGroup {
+public:
+	/**
+	 * A policy assigning devices to shards.
+	 *
+	 * The function gets the bus number and the port numbers of a device
+	 * and returns the shard index. Values larger than the number of shards
+	 * wrap around.
+	 */
+	typedef std::function<std::size_t(uint8_t bus, const std::vector<uint8_t>& ports)> Policy;
+
+	/**
+	 * Constructs a group distributing the devices by the bus number.
+	 *
+	 * The event loop of shard \a i is pinned to CPU \a i modulo the number of CPUs.
+	 *
+	 * \param shards number of contexts in the group
+	 */
+	explicit ContextGroup(std::size_t shards);
+	/**
+	 * Constructs a group distributing the devices using a custom policy.
+	 *
+	 * The event loop of shard \a i is pinned to CPU \a i modulo the number of CPUs.
+	 *
+	 * \param shards number of contexts in the group
+	 * \param policy function assigning devices to shards
+	 */
+	ContextGroup(std::size_t shards, const Policy& policy);
+	/**
+	 * A destructor.
+	 *
+	 * Stops all event loops.
+	 */
+	~ContextGroup();
+
+	// the shards are referenced by the registered callbacks
+	ContextGroup(const ContextGroup& other) = delete;
+	ContextGroup& operator=(const ContextGroup& other) = delete;
+
+	/**
+	 * Get the number of shards.
+	 */
+	std::size_t size() const;
+	/**
+	 * Get the context of a shard.
+	 */
+	Context& getContext(std::size_t shard);
+	/**
+	 * Get the index of the shard owning the device.
+	 */
+	std::size_t getShard(const Device& device) const;
+
+	/**
+	 * Pin the event loops to CPUs.
+	 *
+	 * \param cpus CPU for each shard, -1 allows all CPUs. Shards without
+	 *        an entry are not changed.
+	 */
+	void setEventLoopAffinity(const std::vector<int>& cpus);
+
+	/**
+	 * Get list of currently attached USB devices from all shards.
+	 */
+	std::vector<Device> getDevices();
+	/**
+	 * Find all attached devices with the given vendor and product ID.
+	 *
+	 * \see Context::findDevices()
+	 */
+	std::vector<Device> findDevices(uint16_t vendorId, uint16_t productId);
+	/**
+	 * Find a device by its serial number.
+	 *
+	 * \see Context::findDeviceBySerial()
+	 */
+	Device findDeviceBySerial(const std::string& serial);
+	/**
+	 * Find a device by its position in the USB topology.
+	 *
+	 * \see Context::findDeviceByPath()
+	 */
+	Device findDeviceByPath(uint8_t bus, const std::vector<uint8_t>& ports);
+
+	/**
+	 * Register a function that is called when a new device is connected.
+	 *
+	 * The function is called from the event loop of the shard owning the device.
+	 *
+	 * \see Context::registerDeviceConnected()
+	 */
+	int registerDeviceConnected(const std::function<void(Device&)>& func);
+	/**
+	 * Register a function that is called when a device is removed.
+	 *
+	 * The function is called from the event loop of the shard owning the device.
+	 *
+	 * \see Context::registerDeviceDisconnected()
+	 */
+	int registerDeviceDisconnected(const std::function<void(Device&)>& func);
+	/**
+	 * Register a function that is called with a batch of connected and removed devices.
+	 *
+	 * Each shard delivers its own batches from its event loop.
+	 *
+	 * \see Context::registerDevicesChanged()
+	 */
+	int registerDevicesChanged(const std::function<void(const std::vector<Device>& connected,
+	                                                    const std::vector<Device>& disconnected)>& func);
+	void unregisterDeviceConnected(int handle);
+	void unregisterDeviceDisconnected(int handle);
+	void unregisterDevicesChanged(int handle);
+
+	/**
+	 * Set the hotplug event coalescing window of all shards.
+	 *
+	 * \see Context::setHotplugCoalescing()
+	 */
+	void setHotplugCoalescing(unsigned int window);
+
+private:
+	class Impl;
+	std::unique_ptr<Impl> pimpl;
+};
+
+}
+
+#endif
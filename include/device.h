@@ -19,18 +19,22 @@
 #define LIBUSBPP_DEVICE_H_
 
 #include <exception>
+#include <functional>
 #include <memory>
 #include <string>
+#include <vector>
 
 #include "buffer.h"
 #include "exception.h"
 #include "stddevicehash.h"
 
+struct libusb_context;
 struct libusb_device_descriptor;
 struct libusb_device;
 
 namespace Usbpp {
 
+class BufferChain;
 class Context;
 
 /**
@@ -55,6 +59,18 @@ public:
 	virtual const char* what() const noexcept;
 };
 
+/**
+ * A function called when an asynchronous transfer finishes.
+ *
+ * \param error 0 if the transfer succeeded or the libusb error otherwise.
+ * \param transferred Number of bytes actually transferred.
+ */
+typedef std::function<void(int error, int transferred)> TransferCallback;
+
+#ifdef USBPP_COROUTINES
+class TransferAwaitable;
+#endif
+
 /**
  * An USB device.
  *
@@ -63,6 +79,9 @@ public:
 class Device {
 public:
 	friend class Context;
+	friend class InterruptPoller;
+	friend class StreamReader;
+	friend class StreamWriter;
 	friend struct std::hash<Device>;
 
 	/**
@@ -157,6 +176,34 @@ public:
 	 */
 	libusb_device_descriptor getDescriptor();
 
+	/**
+	 * Get the number of the bus the device is connected to.
+	 *
+	 * \return The bus number.
+	 */
+	uint8_t getBusNumber() const;
+
+	/**
+	 * Get the port numbers on the path from the root hub to the device.
+	 *
+	 * Together with the bus number, the port numbers identify the physical
+	 * position of the device in the USB topology.
+	 *
+	 * \return List of port numbers, starting with the port of the root hub.
+	 */
+	std::vector<uint8_t> getPortNumbers() const;
+
+	/**
+	 * Get a string descriptor converted to ASCII.
+	 *
+	 * The device must be opened before calling this function.
+	 *
+	 * \param index Index of the string descriptor, e.g. the iSerialNumber field
+	 *        of the device descriptor.
+	 * \return The string descriptor.
+	 */
+	std::string getStringDescriptor(uint8_t index) const;
+
 	/**
 	 * Get the device configuration.
 	 *
@@ -210,6 +257,10 @@ public:
 	/**
 	 * Bulk transfer from the device to the computer ("receive").
 	 *
+	 * If enabled by setBulkChunking(), transfers larger than the chunk size
+	 * are split into chunks that are kept in flight concurrently. A short
+	 * packet terminates the whole transfer.
+	 *
 	 * \param endpoint The address of a valid endpoint to communicate with.
 	 * \param data Buffer where the received data will be stored. The buffer must
 	 *        be preallocated to the maximum expected amount of data.
@@ -258,6 +309,9 @@ public:
 	/**
 	 * Bulk transfer from computer to device ("send").
 	 *
+	 * If enabled by setBulkChunking(), transfers larger than the chunk size
+	 * are split into chunks that are kept in flight concurrently.
+	 *
 	 * \param endpoint The address of a valid endpoint to communicate with.
 	 * \param data Buffer with data to send.
 	 * \param timeout timeout (in millseconds) that this function should wait
@@ -268,6 +322,25 @@ public:
 	int bulkTransferOut(unsigned char endpoint,
 	                    const ByteBuffer& data,
 	                    unsigned int timeout) const;
+	/**
+	 * Bulk transfer of a buffer chain from computer to device ("send").
+	 *
+	 * If all segments but the last one are a multiple of the endpoint's
+	 * maximum packet size, each segment is sent directly from its buffer,
+	 * because the device cannot tell the difference from a single transfer.
+	 * Otherwise, a segment would end with a short packet terminating
+	 * the transfer early, so the chain is copied to a contiguous buffer first.
+	 *
+	 * \param endpoint The address of a valid endpoint to communicate with.
+	 * \param data The chain with data to send.
+	 * \param timeout timeout (in millseconds) that this function should wait
+	 *        before giving up due to no response being received.
+	 *        For an unlimited timeout, use value 0.
+	 * \return Number of bytes actually transferred.
+	 */
+	int bulkTransferOut(unsigned char endpoint,
+	                    const BufferChain& data,
+	                    unsigned int timeout) const;
 	/**
 	 * Interrupt transfer from computer to device ("send").
 	 *
@@ -282,12 +355,205 @@ public:
 	                         const ByteBuffer& data,
 	                         unsigned int timeout) const;
 
+	/**
+	 * Set how the large synchronous bulk transfers are split.
+	 *
+	 * Handing a single huge request to libusb may fail or perform poorly
+	 * because of the limits of the operating system (e.g. the usbfs memory
+	 * limit on Linux). Therefore, bulkTransferOut() can split the transfers
+	 * larger than \a chunkSize into chunks, keeping up to \a depth of them
+	 * submitted at once. The timeout applies to each chunk. Splitting is
+	 * disabled by default.
+	 *
+	 * The IN transfers are split only if \a splitIn is set. A short packet
+	 * ends the transfer: the chunks following the short one are cancelled
+	 * and the number of bytes received up to and including the short packet
+	 * is returned. The data the cancelled chunks may have already received
+	 * is lost, so this is safe only if the device always fills the whole
+	 * buffer or if nothing else follows on the endpoint (which is not
+	 * the case for e.g. the mass storage status wrapper).
+	 *
+	 * The setting is shared by the copies of the device made afterwards.
+	 * Regardless of the setting, the buffers larger than INT_MAX bytes are
+	 * rejected with a DeviceTransferException.
+	 *
+	 * \param chunkSize size of a chunk, 0 disables splitting; other values are
+	 *        rounded down to a multiple of 1024 bytes to keep the chunks
+	 *        a multiple of the packet size, but to no less than 1024 bytes
+	 * \param depth maximum number of chunks in flight
+	 * \param splitIn whether to split the IN transfers as well
+	 */
+	void setBulkChunking(std::size_t chunkSize, unsigned int depth, bool splitIn = false);
+
+	/**
+	 * Asynchronous bulk transfer from the device to the computer ("receive").
+	 *
+	 * The function returns immediately after the transfer is submitted.
+	 * The \a callback is called from the event loop of the context when
+	 * the transfer finishes, see Context::startEventLoop().
+	 *
+	 * \param endpoint The address of a valid endpoint to communicate with.
+	 * \param data Buffer where the received data will be stored. The buffer must
+	 *        be preallocated to the maximum expected amount of data and it must
+	 *        remain valid until the callback is called.
+	 * \param timeout timeout (in millseconds) of the transfer.
+	 *        For an unlimited timeout, use value 0.
+	 * \param callback Function called when the transfer finishes.
+	 */
+	void bulkTransferInAsync(unsigned char endpoint,
+	                         ByteBuffer& data,
+	                         unsigned int timeout,
+	                         const TransferCallback& callback) const;
+	/**
+	 * Asynchronous interrupt transfer from the device to the computer ("receive").
+	 *
+	 * \copydetails bulkTransferInAsync()
+	 */
+	void interruptTransferInAsync(unsigned char endpoint,
+	                              ByteBuffer& data,
+	                              unsigned int timeout,
+	                              const TransferCallback& callback) const;
+	/**
+	 * Asynchronous bulk transfer from computer to device ("send").
+	 *
+	 * The function returns immediately after the transfer is submitted.
+	 * The \a callback is called from the event loop of the context when
+	 * the transfer finishes, see Context::startEventLoop().
+	 *
+	 * \param endpoint The address of a valid endpoint to communicate with.
+	 * \param data Buffer with data to send. The buffer must remain valid until
+	 *        the callback is called.
+	 * \param timeout timeout (in millseconds) of the transfer.
+	 *        For an unlimited timeout, use value 0.
+	 * \param callback Function called when the transfer finishes.
+	 */
+	void bulkTransferOutAsync(unsigned char endpoint,
+	                          const ByteBuffer& data,
+	                          unsigned int timeout,
+	                          const TransferCallback& callback) const;
+	/**
+	 * Asynchronous interrupt transfer from computer to device ("send").
+	 *
+	 * \copydetails bulkTransferOutAsync()
+	 */
+	void interruptTransferOutAsync(unsigned char endpoint,
+	                               const ByteBuffer& data,
+	                               unsigned int timeout,
+	                               const TransferCallback& callback) const;
+	/**
+	 * Asynchronous control transfer from the device to the computer ("receive").
+	 *
+	 * The function returns immediately after the transfer is submitted.
+	 * The \a callback is called from the event loop of the context when
+	 * the transfer finishes, see Context::startEventLoop().
+	 *
+	 * \param bmRequestType The request type field for the setup packet.
+	 * \param bRequest The request field for the setup packet.
+	 * \param wValue The value field for the setup packet.
+	 * \param wIndex The index field for the setup packet.
+	 * \param data Buffer where the received data will be stored. The buffer must
+	 *        be preallocated to store received data and it must remain valid
+	 *        until the callback is called.
+	 * \param timeout timeout (in millseconds) of the transfer.
+	 *        For an unlimited timeout, use value 0.
+	 * \param callback Function called when the transfer finishes.
+	 */
+	void controlTransferInAsync(uint8_t bmRequestType,
+	                            uint8_t bRequest,
+	                            uint16_t wValue,
+	                            uint16_t wIndex,
+	                            ByteBuffer& data,
+	                            unsigned int timeout,
+	                            const TransferCallback& callback) const;
+	/**
+	 * Asynchronous control transfer from computer to device ("send").
+	 *
+	 * The function returns immediately after the transfer is submitted.
+	 * The \a callback is called from the event loop of the context when
+	 * the transfer finishes, see Context::startEventLoop().
+	 *
+	 * \param bmRequestType The request type field for the setup packet.
+	 * \param bRequest The request field for the setup packet.
+	 * \param wValue The value field for the setup packet.
+	 * \param wIndex The index field for the setup packet.
+	 * \param data Buffer with data to send. The data are copied, so the buffer
+	 *        doesn't need to remain valid after the function returns.
+	 * \param timeout timeout (in millseconds) of the transfer.
+	 *        For an unlimited timeout, use value 0.
+	 * \param callback Function called when the transfer finishes.
+	 */
+	void controlTransferOutAsync(uint8_t bmRequestType,
+	                             uint8_t bRequest,
+	                             uint16_t wValue,
+	                             uint16_t wIndex,
+	                             const ByteBuffer& data,
+	                             unsigned int timeout,
+	                             const TransferCallback& callback) const;
+
+#ifdef USBPP_COROUTINES
+	/**
+	 * Awaitable control transfer from the device to the computer ("receive").
+	 *
+	 * The coroutine is resumed from the event loop of the context when
+	 * the transfer finishes. The result of co_await is the number of bytes
+	 * actually transferred, DeviceTransferException is thrown on failure.
+	 *
+	 * \copydetails controlTransferIn()
+	 */
+	TransferAwaitable controlIn(uint8_t bmRequestType,
+	                            uint8_t bRequest,
+	                            uint16_t wValue,
+	                            uint16_t wIndex,
+	                            ByteBuffer& data,
+	                            unsigned int timeout = 0) const;
+	/**
+	 * Awaitable control transfer from computer to device ("send").
+	 *
+	 * \copydetails controlTransferOut()
+	 */
+	TransferAwaitable controlOut(uint8_t bmRequestType,
+	                             uint8_t bRequest,
+	                             uint16_t wValue,
+	                             uint16_t wIndex,
+	                             const ByteBuffer& data,
+	                             unsigned int timeout = 0) const;
+	/**
+	 * Awaitable bulk transfer from the device to the computer ("receive").
+	 *
+	 * \copydetails bulkTransferIn()
+	 */
+	TransferAwaitable bulkIn(unsigned char endpoint, ByteBuffer& data, unsigned int timeout = 0) const;
+	/**
+	 * Awaitable bulk transfer from computer to device ("send").
+	 *
+	 * \copydetails bulkTransferOut()
+	 */
+	TransferAwaitable bulkOut(unsigned char endpoint, const ByteBuffer& data, unsigned int timeout = 0) const;
+	/**
+	 * Awaitable interrupt transfer from the device to the computer ("receive").
+	 *
+	 * \copydetails interruptTransferIn()
+	 */
+	TransferAwaitable interruptIn(unsigned char endpoint, ByteBuffer& data, unsigned int timeout = 0) const;
+	/**
+	 * Awaitable interrupt transfer from computer to device ("send").
+	 *
+	 * \copydetails interruptTransferOut()
+	 */
+	TransferAwaitable interruptOut(unsigned char endpoint, const ByteBuffer& data, unsigned int timeout = 0) const;
+#endif
+
 private:
-	explicit Device(libusb_device* device_);
+	Device(libusb_device* device_, libusb_context* context);
 	class Impl;
 	std::unique_ptr<Impl> pimpl;
 };
 
 }
 
+#ifdef USBPP_COROUTINES
+// the awaitable transfers are defined inline in awaitable.h
+#include "awaitable.h"
+#endif
+
 #endif
@@ -0,0 +1,134 @@
+/*
+ * This file is part of Usbpp, a C++ wrapper around libusb
+ * Copyright (C) 2016  Lukas Jirkovsky <l.jirkovsky @at@ gmail.com>
+ *
+ * Usbpp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, version 3 of the License
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBUSBPP_FILESINK_H_
+#define LIBUSBPP_FILESINK_H_
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "exception.h"
+#include "streamsink.h"
+
+namespace Usbpp {
+
+/**
+ * An exception thrown when the file of a FileSink cannot be created or mapped.
+ *
+ * The error is the errno value rather than a libusb error.
+ */
+class FileSinkException : public Exception {
+public:
+	explicit FileSinkException(int error) noexcept;
+	virtual ~FileSinkException();
+
+	virtual const char* what() const noexcept;
+	virtual std::string getDescription() const;
+};
+
+/**
+ * Statistics of a FileSink.
+ */
+struct FileSinkStatistics {
+	/// number of bytes stored in all files
+	std::uint64_t bytesWritten;
+	/// number of bytes that had to be moved to close the gaps after short transfers
+	std::uint64_t bytesMoved;
+	/// number of transfers discarded because the sink could not provide a buffer
+	std::uint64_t dropped;
+	/// number of bytes discarded because the sink could not provide a buffer
+	std::uint64_t droppedBytes;
+	/// number of files created
+	std::uint64_t files;
+	/// errno of the last failure to grow, map or rotate the file, 0 if none
+	int lastError;
+};
+
+/**
+ * Stores streamed data in memory-mapped files.
+ *
+ * The file is mapped into memory and the transfers of a StreamReader complete
+ * directly into the mapping, so the data are never copied in the user space.
+ * The file is grown ahead of the data in large steps, and the kernel is asked to
+ * start writing out each completed part of the file right away, so the disk
+ * writes are overlapped with the reception. The written parts are then
+ * released from the process memory, so the memory use stays flat.
+ *
+ * Each claimed buffer has the size of one transfer. When a transfer is short,
+ * the data of the transfers already in flight behind it are moved to close
+ * the gap, which is the only case the data are copied. The transfers claimed
+ * after those land in place again.
+ *
+ * The files are rotated when the next buffer would not fit below the maximum
+ * file size or, optionally, after a time interval. The first file is named
+ * \a path, the following files are named \a path.1, \a path.2 etc. Each file
+ * is truncated to the size of its data when it is closed.
+ *
+ * The sink must outlive the reader writing into it.
+ */
+class FileSink : public StreamSink {
+public:
+	/**
+	 * Create the sink and its first file.
+	 *
+	 * \param path path of the first file
+	 * \param transferSize default size of the claimed buffers
+	 * \param maxFileSize size at which the files are rotated
+	 * \param growStep the file is grown ahead of the data in steps of this size
+	 * \throws FileSinkException if the file cannot be created or mapped
+	 */
+	FileSink(const std::string& path,
+	         std::size_t transferSize,
+	         std::uint64_t maxFileSize = std::uint64_t(1) << 36,
+	         std::size_t growStep = 64 << 20);
+	FileSink(const FileSink& other) = delete;
+	/**
+	 * Closes the current file.
+	 */
+	virtual ~FileSink();
+
+	FileSink& operator=(const FileSink& other) = delete;
+
+	virtual std::uint8_t* claim(std::size_t& size);
+	virtual void commit(std::size_t length);
+	virtual void drop(std::size_t length);
+
+	/**
+	 * Rotate the files after a time interval.
+	 *
+	 * \param interval maximum age of a file, zero disables the time based
+	 *        rotation (default)
+	 */
+	void setRotationInterval(std::chrono::seconds interval);
+	/**
+	 * Get the statistics.
+	 *
+	 * Can be called from any thread.
+	 */
+	FileSinkStatistics getStatistics() const;
+
+private:
+	class Impl;
+	std::unique_ptr<Impl> pimpl;
+};
+
+}
+
+#endif
@@ -0,0 +1,92 @@
+/*
+ * This file is part of Usbpp, a C++ wrapper around libusb
+ * Copyright (C) 2016  Lukas Jirkovsky <l.jirkovsky @at@ gmail.com>
+ *
+ * Usbpp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, version 3 of the License
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBUSBPP_FILESOURCE_H_
+#define LIBUSBPP_FILESOURCE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "exception.h"
+#include "streamsource.h"
+
+namespace Usbpp {
+
+/**
+ * An exception thrown when the file of a FileSource cannot be opened or mapped.
+ *
+ * The error is the errno value rather than a libusb error.
+ */
+class FileSourceException : public Exception {
+public:
+	explicit FileSourceException(int error) noexcept;
+	virtual ~FileSourceException();
+
+	virtual const char* what() const noexcept;
+	virtual std::string getDescription() const;
+};
+
+/**
+ * Streams a file using the memory mapping.
+ *
+ * The file is mapped into memory and it is split into windows of a fixed
+ * size, which are sent directly from the mapping by a StreamWriter. The window
+ * following the one being sent is prefetched and the windows that have been
+ * sent are released from memory, so only the windows in flight are resident
+ * and the memory use does not depend on the size of the file.
+ */
+class FileSource : public StreamSource {
+public:
+	/**
+	 * Open and map the file.
+	 *
+	 * \param path path of the file
+	 * \param windowSize default size of each transfer, rounded up to the page
+	 *        size (as are the explicitly requested sizes), which keeps
+	 *        the windows aligned and a multiple of the packet size
+	 * \throws FileSourceException if the file cannot be opened or mapped
+	 */
+	explicit FileSource(const std::string& path, std::size_t windowSize = 1 << 20);
+	FileSource(const FileSource& other) = delete;
+	virtual ~FileSource();
+
+	FileSource& operator=(const FileSource& other) = delete;
+
+	virtual const std::uint8_t* next(std::size_t& size);
+	virtual void release(std::size_t length);
+
+	/**
+	 * Get the size of the file.
+	 */
+	std::uint64_t getSize() const;
+	/**
+	 * Get the number of bytes whose transfers have finished.
+	 *
+	 * Can be called from any thread.
+	 */
+	std::uint64_t getBytesReleased() const;
+
+private:
+	class Impl;
+	std::unique_ptr<Impl> pimpl;
+};
+
+}
+
+#endif
@@ -0,0 +1,142 @@
+/*
+ * This file is part of Usbpp, a C++ wrapper around libusb
+ * Copyright (C) 2016  Lukas Jirkovsky <l.jirkovsky @at@ gmail.com>
+ *
+ * Usbpp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, version 3 of the License
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBUSBPP_HID_LAYOUT_H_
+#define LIBUSBPP_HID_LAYOUT_H_
+
+#include "bufferview.h"
+#include "hidreport.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace Usbpp {
+namespace HID {
+
+/**
+ * A single field of a HID report.
+ *
+ * Each element of a main item (as given by the Report Count) is a separate
+ * field. The constant (padding) elements have no field.
+ */
+struct ReportField {
+	/// offset of the first bit in the report, including the report ID byte
+	std::uint32_t bitOffset;
+	/// size of the field in bits, fields larger than 32 bits are truncated
+	std::uint8_t bitSize;
+	/// whether the value is signed, i.e. the logical minimum is negative
+	bool isSigned;
+	/// whether the value is an index to the usage range (an array item)
+	bool isArray;
+	/// data bits of the main item (Constant, Variable, Relative, ...)
+	std::uint32_t flags;
+	/// logical minimum
+	std::int32_t logicalMinimum;
+	/// logical maximum
+	std::int32_t logicalMaximum;
+	/// usage with the usage page in the upper 16 bits, the first usage of the range for arrays
+	std::uint32_t usage;
+	/// the last usage of the range for arrays, the same as usage for variables
+	std::uint32_t usageMaximum;
+};
+
+/**
+ * A compiled layout of the reports of a HID device.
+ *
+ * The layout flattens a ReportTree into a table of fields for each report
+ * type and Report ID, so that the reports received from the device can be
+ * decoded in a single pass without looking up the items of the tree.
+ */
+class ReportLayout {
+public:
+	/**
+	 * Compile the layout of the reports described by \a tree.
+	 */
+	explicit ReportLayout(const ReportTree& tree);
+	ReportLayout(const ReportLayout& other);
+	ReportLayout(ReportLayout&& other) noexcept;
+	~ReportLayout();
+
+	ReportLayout& operator=(const ReportLayout& other);
+	ReportLayout& operator=(ReportLayout&& other) noexcept;
+
+	/**
+	 * Whether the reports start with a Report ID byte.
+	 */
+	bool usesReportIds() const;
+
+	/**
+	 * Get the fields of a report.
+	 *
+	 * \param reportId the Report ID, 0 if Report IDs are not used
+	 * \param type INPUT, OUTPUT or FEATURE
+	 * \return the fields ordered by their offset
+	 */
+	const std::vector<ReportField>& getFields(std::uint8_t reportId,
+	                                          ReportItem::TagsMain type = ReportItem::TagsMain::INPUT) const;
+
+	/**
+	 * Get the length of a report in bytes, including the Report ID byte.
+	 *
+	 * \param reportId the Report ID, 0 if Report IDs are not used
+	 * \param type INPUT, OUTPUT or FEATURE
+	 */
+	std::size_t getReportLength(std::uint8_t reportId,
+	                            ReportItem::TagsMain type = ReportItem::TagsMain::INPUT) const;
+
+	/**
+	 * Decode all fields of an input report.
+	 *
+	 * The report is decoded by a program compiled together with the layout:
+	 * the byte-aligned fields of 8, 16 and 32 bits are read directly, the other
+	 * fields are extracted in blocks of eight using AVX2 if the CPU supports it
+	 * (see isVectorized()) or using 32-bit word operations otherwise.
+	 * The fields missing in a short report are decoded as zero.
+	 *
+	 * \param report the report as received from the device
+	 * \param values receives the value of each field in the order given
+	 *        by getFields(), the signed fields are sign-extended, the unsigned
+	 *        32-bit fields should be cast to std::uint32_t. The storage is
+	 *        reused, so decoding many reports doesn't allocate.
+	 * \return the Report ID of the report, 0 if Report IDs are not used
+	 */
+	std::uint8_t decode(ByteBufferView report, std::vector<std::int32_t>& values) const;
+
+	/**
+	 * Extract the value of a single field from a report.
+	 *
+	 * \param report the report as received from the device
+	 * \param field the field to extract
+	 */
+	static std::int32_t extract(ByteBufferView report, const ReportField& field);
+
+	/**
+	 * Whether decode() uses SIMD instructions on this CPU.
+	 */
+	static bool isVectorized();
+
+private:
+	class Impl;
+	std::unique_ptr<Impl> pimpl;
+};
+
+}
+}
+
+#endif
@@ -19,6 +19,7 @@
 #define LIBUSBPP_HID_REPORT_H_
 
 #include "buffer.h"
+#include "bufferview.h"
 
 #include <cstddef>
 #include <cstdint>
@@ -107,17 +108,32 @@ public:
 	std::uint8_t getTag() const;
 	/**
 	 * the additional payload.
+	 *
+	 * The view refers to a copy of the report descriptor shared by all
+	 * the items of a ReportTree, it stays valid as long as the item exists.
+	 */
+	ByteBufferView getData() const;
+	/**
+	 * Get the payload of a short item as an unsigned number.
+	 *
+	 * \return the little-endian payload zero-extended to 32 bits
 	 */
-	const ByteBuffer& getData() const;
+	std::uint32_t getUnsigned() const;
+	/**
+	 * Get the payload of a short item as a signed number.
+	 *
+	 * \return the little-endian payload sign-extended to 32 bits
+	 */
+	std::int32_t getSigned() const;
 private:
 	friend class ReportTree;
 
 	/**
 	 * A constructor.
 	 *
-	 * Constructs the item from the binary data.
+	 * Constructs the item from the binary data at \a offset in the descriptor.
 	 */
-	explicit ReportItem(const std::uint8_t* data);
+	ReportItem(const std::shared_ptr<const ByteBuffer>& descriptor, std::size_t offset);
 
 	class Impl;
 	std::unique_ptr<Impl> pimpl;
@@ -155,6 +171,16 @@ public:
 	 * @return map of local items valid for the current main item.
 	 */
 	const LocalItemMap& getLocalState() const;
+	/**
+	 * Get all the Usage items of the local state.
+	 *
+	 * The local state map holds only the last Usage item, while a main item
+	 * may be preceded by several of them (one for each field).
+	 *
+	 * @return the Usage items valid for the current main item in the order
+	 *         of their appearance.
+	 */
+	const std::vector<ReportItem>& getUsages() const;
 	/**
 	 * Get the main item associated with the node.
 	 *
@@ -185,7 +211,8 @@ private:
 	ReportNode(const Ptr& parent_,
 	           const ReportItem& item_,
 	           const GlobalItemMap& globalState_,
-	           const LocalItemMap& localState_);
+	           const LocalItemMap& localState_,
+	           const std::vector<ReportItem>& usages_);
 
 	class Impl;
 	std::unique_ptr<Impl> pimpl;
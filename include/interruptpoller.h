@@ -0,0 +1,129 @@
+/*
+ * This file is part of Usbpp, a C++ wrapper around libusb
+ * Copyright (C) 2016  Lukas Jirkovsky <l.jirkovsky @at@ gmail.com>
+ *
+ * Usbpp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, version 3 of the License
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBUSBPP_INTERRUPTPOLLER_H_
+#define LIBUSBPP_INTERRUPTPOLLER_H_
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+
+#include "device.h"
+#include "streamsink.h"
+
+namespace Usbpp {
+
+/**
+ * A report received from an interrupt endpoint.
+ */
+struct InterruptReport {
+	/// number of the transfer, counted from 0 since the poller was started
+	std::uint64_t sequence;
+	/// time when the transfer completion was handled
+	std::chrono::steady_clock::time_point timestamp;
+	/// 0 if the transfer succeeded or the libusb error otherwise
+	int error;
+	/// the received data, valid only during the callback
+	const unsigned char* data;
+	/// number of bytes received
+	int length;
+};
+
+/**
+ * Continuously polls an interrupt IN endpoint.
+ *
+ * The poller keeps one or more interrupt transfers submitted on the endpoint
+ * at all times. A finished transfer is resubmitted directly from the event
+ * loop, so no report is missed even if the application thread is not
+ * scheduled for a while. Each report is passed to a callback together with
+ * a monotonic timestamp and a sequence number, a gap in the sequence numbers
+ * is never caused by the poller itself.
+ *
+ * The event loop of the device's context must be running, see
+ * Context::startEventLoop().
+ */
+class InterruptPoller {
+public:
+	/**
+	 * A function called for each received report from the event loop.
+	 */
+	typedef std::function<void(const InterruptReport& report)> ReportCallback;
+
+	/**
+	 * Create a poller.
+	 *
+	 * \param device an open device with the interface of the endpoint claimed
+	 * \param endpoint address of the interrupt IN endpoint
+	 * \param reportSize maximum size of a report, usually wMaxPacketSize of the endpoint
+	 * \param transfers number of transfers kept submitted
+	 */
+	InterruptPoller(const Device& device, unsigned char endpoint, std::size_t reportSize, unsigned int transfers = 2);
+	InterruptPoller(const InterruptPoller& other) = delete;
+	/**
+	 * Stops the poller.
+	 */
+	~InterruptPoller();
+
+	InterruptPoller& operator=(const InterruptPoller& other) = delete;
+
+	/**
+	 * Start polling.
+	 *
+	 * Failed transfers are reported to the callback with the error set and
+	 * resubmitted. The polling stops by itself (see isRunning()) when
+	 * the device is disconnected, when the endpoint is halted
+	 * (LIBUSB_ERROR_PIPE) and after 8 failed transfers in a row. To resume
+	 * polling a halted endpoint, call Device::clearHalt() and start() again.
+	 *
+	 * \param callback function called for each report
+	 * \throws DeviceTransferException if the transfers cannot be submitted
+	 */
+	void start(const ReportCallback& callback);
+	/**
+	 * Start polling into a sink.
+	 *
+	 * Each successfully received report is copied into a buffer claimed from
+	 * the \a sink (e.g. a StreamRing), so it can be processed by another thread
+	 * without locking. Reports received while the sink is full are dropped.
+	 * The timestamps and sequence numbers are not stored, use the callback
+	 * variant if they are needed.
+	 *
+	 * \param sink destination of the reports, it must outlive the poller
+	 * \throws DeviceTransferException if the transfers cannot be submitted
+	 */
+	void start(StreamSink& sink);
+	/**
+	 * Stop polling.
+	 *
+	 * Cancels the submitted transfers and waits until they finish.
+	 * Must not be called from the callback.
+	 */
+	void stop();
+	/**
+	 * Check whether any transfer is still submitted.
+	 */
+	bool isRunning() const;
+
+private:
+	class Impl;
+	std::unique_ptr<Impl> pimpl;
+};
+
+}
+
+#endif
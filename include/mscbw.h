@@ -19,6 +19,7 @@
 #define LIBUSBPP_MASS_CBW_H_
 
 #include "buffer.h"
+#include "bufferview.h"
 
 #include <cstdint>
 #include <vector>
@@ -57,7 +58,12 @@ public:
 	 */
 	uint8_t getLun() const;
 	uint8_t getCommandBlockLength() const;
-	std::vector<uint8_t> getCommandBlock() const;
+	/**
+	 * Get the command block.
+	 *
+	 * The returned view is valid only as long as the wrapper exists.
+	 */
+	ByteBufferView getCommandBlock() const;
 
 	const ByteBuffer& getBuffer() const;
 
@@ -64,6 +64,17 @@ public:
 	MSDevice& operator=(MSDevice&& other) noexcept = default;
 
 	CommandStatusWrapper sendCommand(unsigned char endpoint, const CommandBlockWrapper& command, ByteBuffer* data);
+#ifdef USBPP_COROUTINES
+	/**
+	 * Awaitable version of sendCommand().
+	 *
+	 * The command is taken by value, as it must remain valid until the task
+	 * finishes. The \a data buffer (if any) must remain valid as well, and so
+	 * must this MSDevice: the task refers to it, so destroying the device while
+	 * the task (even a detached one) is suspended is undefined behaviour.
+	 */
+	Task<CommandStatusWrapper> sendCommandAsync(unsigned char endpoint, CommandBlockWrapper command, ByteBuffer* data);
+#endif
 
 	/**
 	 * A convenience function to send the SCSI Inquiry command.
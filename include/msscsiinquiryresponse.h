@@ -19,17 +19,24 @@
 #define LIBUSBPP_MASS_SCSI_INQUIRYRESPONSE_H_
 
 #include "buffer.h"
+#include "bufferview.h"
 
 namespace Usbpp {
 namespace MassStorage {
 namespace SCSI {
 
+/**
+ * Response to the SCSI INQUIRY command.
+ *
+ * The multi-byte fields are returned as views of the response data,
+ * they are valid only as long as the InquiryResponse object exists.
+ */
 class InquiryResponse {
 public:
 	explicit InquiryResponse(const ByteBuffer& buffer);
 	InquiryResponse(const InquiryResponse& other);
 	InquiryResponse(InquiryResponse&& other) noexcept;
-	InquiryResponse& operator=(InquiryResponse& other) = default;
+	InquiryResponse& operator=(const InquiryResponse& other) = default;
 	InquiryResponse& operator=(InquiryResponse&& other) noexcept = default;
 
 	uint8_t getPeripheralQualifier() const;
@@ -55,19 +62,19 @@ public:
 	bool getLINKED() const;
 	bool getCMDQUE() const;
 
-	ByteBuffer getVendorIdentification() const;
-	ByteBuffer getProductIdentification() const;
-	ByteBuffer getProductRevisionLevel() const;
+	ByteBufferView getVendorIdentification() const;
+	ByteBufferView getProductIdentification() const;
+	ByteBufferView getProductRevisionLevel() const;
 
 	/********************************
 	 * fields that may not be present
 	 *******************************/
 
-	ByteBuffer getDriverSerialNumber() const;
+	ByteBufferView getDriverSerialNumber() const;
 	/**
 	 * Get the vendor unique bits: bit 44 - 55
 	 */
-	ByteBuffer getVendorUnique() const;
+	ByteBufferView getVendorUnique() const;
 
 	uint8_t getClocking() const;
 	bool getQAS() const;
@@ -78,9 +85,9 @@ public:
 	 *
 	 * \param descriptor a descriptor in range 0-7
 	 */
-	ByteBuffer getVersionDescriptor(unsigned int descriptor) const;
+	ByteBufferView getVersionDescriptor(unsigned int descriptor) const;
 
-	ByteBuffer getVendorSpecific() const;
+	ByteBufferView getVendorSpecific() const;
 
 private:
 	ByteBuffer m_buffer;
@@ -0,0 +1,105 @@
+/*
+ * This file is part of Usbpp, a C++ wrapper around libusb
+ * Copyright (C) 2016  Lukas Jirkovsky <l.jirkovsky @at@ gmail.com>
+ *
+ * Usbpp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, version 3 of the License
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBUSBPP_PROBE_H_
+#define LIBUSBPP_PROBE_H_
+
+#include "buffer.h"
+#include "device.h"
+#include "msscsiinquiryresponse.h"
+
+#include <cstdint>
+#include <map>
+#include <string>
+
+namespace Usbpp {
+
+/**
+ * Options for probing devices using Context::probeDevices().
+ */
+struct ProbeOptions {
+	/**
+	 * Probing steps performed in addition to reading the device descriptor.
+	 */
+	enum Steps : unsigned int {
+		/** Read the manufacturer, product and serial number strings. */
+		STRINGS = 0x1,
+		/** Read the report descriptors of all HID interfaces. */
+		HID_REPORT = 0x2,
+		/** Send SCSI Inquiry to all bulk-only mass storage interfaces. */
+		SCSI_INQUIRY = 0x4
+	};
+
+	/**
+	 * Constructs the default options.
+	 *
+	 * By default, strings are read from up to 8 devices at once with a timeout
+	 * of 2 seconds per device.
+	 */
+	ProbeOptions();
+
+	/** Combination of Steps to perform. */
+	unsigned int steps;
+	/** Maximum number of devices probed at the same time. */
+	unsigned int concurrency;
+	/**
+	 * Time (in milliseconds) for probing a single device.
+	 *
+	 * The remaining time is used as the timeout of each transfer. When the time
+	 * runs out, the remaining steps are skipped. Note that the SCSI Inquiry
+	 * always uses the default timeouts of MassStorage::MSDevice.
+	 */
+	unsigned int timeout;
+	/**
+	 * Detach the kernel driver when claiming mass storage interfaces. The HID
+	 * report descriptors are read without claiming the interface.
+	 */
+	bool detachDriver;
+};
+
+/**
+ * Result of probing a single device.
+ */
+struct ProbeResult {
+	ProbeResult();
+
+	/** The probed device. */
+	Device device;
+	/**
+	 * The libusb error of the first failed step or 0 if all steps succeeded.
+	 */
+	int error;
+	/** True if some steps were skipped because the device timed out. */
+	bool timedOut;
+
+	uint16_t vendorId;
+	uint16_t productId;
+	uint8_t deviceClass;
+
+	std::string manufacturer;
+	std::string product;
+	std::string serialNumber;
+
+	/** Raw HID report descriptors indexed by the interface number. */
+	std::map<int, ByteBuffer> hidReports;
+	/** SCSI Inquiry responses indexed by the interface number. */
+	std::map<int, MassStorage::SCSI::InquiryResponse> inquiries;
+};
+
+}
+
+#endif
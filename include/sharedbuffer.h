@@ -0,0 +1,131 @@
+/*
+ * This file is part of Usbpp, a C++ wrapper around libusb
+ * Copyright (C) 2016  Lukas Jirkovsky <l.jirkovsky @at@ gmail.com>
+ *
+ * Usbpp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, version 3 of the License
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBUSBPP_SHAREDBUFFER_H_
+#define LIBUSBPP_SHAREDBUFFER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include "buffer.h"
+#include "bufferview.h"
+
+namespace Usbpp {
+
+/**
+ * An immutable reference-counted buffer.
+ *
+ * Copies of a SharedBuffer share the same storage, the copy only increments
+ * an atomic reference count. This makes it possible to hand one received
+ * buffer to several consumers (and threads) without copying the data.
+ * A SharedBuffer may also refer just to a part of the storage, see slice().
+ *
+ * The data cannot be modified through a SharedBuffer. To modify them,
+ * promote the buffer to a ByteBuffer using toMutable(), which copies
+ * the data only if the storage is still shared.
+ */
+class SharedBuffer {
+public:
+	/**
+	 * Construct an empty buffer.
+	 */
+	SharedBuffer();
+	/**
+	 * Construct a shared buffer taking over the storage of \a buffer.
+	 *
+	 * No data are copied.
+	 */
+	explicit SharedBuffer(ByteBuffer&& buffer);
+	/**
+	 * Construct a shared buffer holding a copy of the data.
+	 *
+	 * \param data Buffer containing data.
+	 * \param size Size of the data buffer in bytes.
+	 */
+	SharedBuffer(const std::uint8_t* data, std::size_t size);
+	SharedBuffer(const SharedBuffer& other);
+	SharedBuffer(SharedBuffer&& other) noexcept;
+	~SharedBuffer();
+
+	SharedBuffer& operator=(const SharedBuffer& other);
+	SharedBuffer& operator=(SharedBuffer&& other) noexcept;
+
+	/**
+	 * Byte access operator.
+	 *
+	 * \param i Byte to access.
+	 * \return Reference to \a i-th byte.
+	 */
+	const std::uint8_t& operator[](std::size_t i) const;
+
+	/**
+	 * Get a buffer referring to a part of this buffer.
+	 *
+	 * The returned buffer shares the storage with this buffer. The range
+	 * is clipped to the bounds of this buffer.
+	 *
+	 * \param offset Offset of the first byte of the part.
+	 * \param length Maximal length of the part.
+	 */
+	SharedBuffer slice(std::size_t offset, std::size_t length) const;
+
+	/**
+	 * Get a view of the data.
+	 *
+	 * The view is valid as long as this buffer exists.
+	 */
+	ByteBufferView view() const;
+
+	/**
+	 * Promote to a mutable buffer.
+	 *
+	 * If this is the only reference to the storage and it refers to all
+	 * of it, the storage is moved to the returned buffer. Otherwise, the data
+	 * are copied. In both cases, this buffer is left empty.
+	 */
+	ByteBuffer toMutable();
+
+	/**
+	 * Whether this is the only reference to the storage.
+	 */
+	bool isUnique() const;
+
+	/**
+	 * Get the size of the data.
+	 */
+	std::size_t size() const;
+
+	/**
+	 * Whether the buffer is empty.
+	 */
+	bool empty() const;
+
+	/**
+	 * Get pointer to the data.
+	 */
+	const std::uint8_t* data() const;
+
+private:
+	std::shared_ptr<ByteBuffer> m_storage;
+	const std::uint8_t* m_data;
+	std::size_t m_size;
+};
+
+}
+
+#endif
@@ -0,0 +1,135 @@
+/*
+ * This file is part of Usbpp, a C++ wrapper around libusb
+ * Copyright (C) 2016  Lukas Jirkovsky <l.jirkovsky @at@ gmail.com>
+ *
+ * Usbpp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, version 3 of the License
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBUSBPP_STREAMREADER_H_
+#define LIBUSBPP_STREAMREADER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include "device.h"
+#include "streamsink.h"
+
+namespace Usbpp {
+
+/**
+ * Streams data from a bulk or interrupt IN endpoint into a StreamSink.
+ *
+ * The reader keeps a number of transfers submitted on the endpoint at all
+ * times. Each transfer completes directly into a buffer claimed from the sink,
+ * so the data are never copied. When the sink is full, the transfer is
+ * submitted into a spare buffer instead and the received data are reported
+ * to the sink as dropped, so the device is never stalled.
+ *
+ * The event loop of the device's context must be running, see
+ * Context::startEventLoop().
+ */
+class StreamReader {
+public:
+	/**
+	 * Create a reader.
+	 *
+	 * \param device an open device with the interface of the endpoint claimed
+	 * \param endpoint address of the IN endpoint
+	 * \param sink destination of the data, it must outlive the reader
+	 * \param transferSize size of the transfers and of the spare buffers, it is
+	 *        also the maximum for setTransferSize()
+	 * \param depth number of transfers kept submitted, it is also the maximum
+	 *        for setQueueDepth()
+	 * \param interrupt true if the endpoint is an interrupt endpoint rather than bulk
+	 */
+	StreamReader(const Device& device,
+	             unsigned char endpoint,
+	             StreamSink& sink,
+	             std::size_t transferSize,
+	             unsigned int depth = 4,
+	             bool interrupt = false);
+	StreamReader(const StreamReader& other) = delete;
+	/**
+	 * Stops the reader.
+	 */
+	~StreamReader();
+
+	StreamReader& operator=(const StreamReader& other) = delete;
+
+	/**
+	 * Start streaming.
+	 *
+	 * The streaming stops by itself (see isRunning()) when the device is
+	 * disconnected, when the endpoint is halted (LIBUSB_ERROR_PIPE) and after
+	 * 8 failed transfers in a row; getLastError() then reports the reason.
+	 * To resume streaming from a halted endpoint, call Device::clearHalt()
+	 * and start() again.
+	 *
+	 * \throws DeviceTransferException if the transfers cannot be submitted
+	 */
+	void start();
+	/**
+	 * Stop streaming.
+	 *
+	 * Cancels the submitted transfers and waits until they finish. The data
+	 * received by the cancelled transfers are still committed to the sink.
+	 */
+	void stop();
+	/**
+	 * Check whether any transfer is still submitted.
+	 */
+	bool isRunning() const;
+	/**
+	 * Set the size of the transfers submitted from now on.
+	 *
+	 * The sink may provide smaller buffers than requested.
+	 *
+	 * \param size the size, at most the transfer size given to the constructor
+	 */
+	void setTransferSize(std::size_t size);
+	/**
+	 * Get the size of the transfers.
+	 */
+	std::size_t getTransferSize() const;
+	/**
+	 * Set the number of transfers kept submitted.
+	 *
+	 * \param depth the number, at most the depth given to the constructor
+	 */
+	void setQueueDepth(unsigned int depth);
+	/**
+	 * Get the number of transfers kept submitted.
+	 */
+	unsigned int getQueueDepth() const;
+	/**
+	 * Get the number of bytes received, including the dropped data.
+	 */
+	std::uint64_t getBytesReceived() const;
+	/**
+	 * Get the number of failed transfers.
+	 */
+	std::uint64_t getErrorCount() const;
+	/**
+	 * Get the libusb error of the last failed transfer.
+	 */
+	int getLastError() const;
+
+private:
+	class Impl;
+	std::unique_ptr<Impl> pimpl;
+};
+
+}
+
+#endif
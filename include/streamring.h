@@ -0,0 +1,144 @@
+/*
+ * This file is part of Usbpp, a C++ wrapper around libusb
+ * Copyright (C) 2016  Lukas Jirkovsky <l.jirkovsky @at@ gmail.com>
+ *
+ * Usbpp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, version 3 of the License
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBUSBPP_STREAMRING_H_
+#define LIBUSBPP_STREAMRING_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "buffer.h"
+#include "streamsink.h"
+
+namespace Usbpp {
+
+/**
+ * Statistics of a StreamRing.
+ */
+struct StreamRingStatistics {
+	/// number of committed slots
+	std::uint64_t committed;
+	/// number of bytes in the committed slots
+	std::uint64_t committedBytes;
+	/// number of transfers discarded because the ring was full
+	std::uint64_t dropped;
+	/// number of bytes discarded because the ring was full
+	std::uint64_t droppedBytes;
+	/// number of times a slot was requested while the ring was full
+	std::uint64_t overruns;
+};
+
+/**
+ * A lock-free single-producer/single-consumer ring of buffers.
+ *
+ * The ring holds a fixed number of preallocated slots of the same size.
+ * The producer (usually the event loop completing the transfers of
+ * a StreamReader) claims free slots, fills them and commits them. The consumer
+ * reads the committed slots using front() and releases them using pop().
+ * No locks are taken and no data are copied. A claimed slot is never larger
+ * than the slot size, but it may be smaller if a smaller buffer is requested.
+ * The producer and consumer indices are kept in separate cache lines to avoid
+ * false sharing.
+ *
+ * The claim() and commit() functions (and the rest of the StreamSink
+ * interface) may be called only from a single producer thread at a time,
+ * the front(), frontLength() and pop() functions only from a single consumer
+ * thread at a time.
+ */
+class StreamRing : public StreamSink {
+public:
+	/**
+	 * Create a ring.
+	 *
+	 * \param slots number of slots, rounded up to a power of two
+	 * \param slotSize size of each slot in bytes
+	 */
+	StreamRing(std::size_t slots, std::size_t slotSize);
+	StreamRing(const StreamRing& other) = delete;
+	virtual ~StreamRing();
+
+	StreamRing& operator=(const StreamRing& other) = delete;
+
+	virtual std::uint8_t* claim(std::size_t& size);
+	virtual void commit(std::size_t length);
+	virtual void drop(std::size_t length);
+
+	/**
+	 * Get the oldest committed slot.
+	 *
+	 * \return the slot or nullptr if there is no committed slot
+	 */
+	const ByteBuffer* front() const;
+	/**
+	 * Get the number of valid bytes in the oldest committed slot.
+	 */
+	std::size_t frontLength() const;
+	/**
+	 * Release the oldest committed slot.
+	 */
+	void pop();
+
+	/**
+	 * Get the number of committed slots waiting for the consumer.
+	 */
+	std::size_t size() const;
+	/**
+	 * Get the number of slots.
+	 */
+	std::size_t capacity() const;
+	/**
+	 * Get the size of each slot.
+	 */
+	std::size_t getSlotSize() const;
+	/**
+	 * Get the statistics.
+	 *
+	 * Can be called from any thread.
+	 */
+	StreamRingStatistics getStatistics() const;
+
+private:
+	static const std::size_t CacheLineSize = 64;
+
+	// read-only after construction
+	std::vector<ByteBuffer> m_slots;
+	std::vector<std::size_t> m_lengths;
+	std::size_t m_mask;
+
+	char m_padding0[CacheLineSize];
+	// written by the producer
+	std::atomic<std::size_t> m_head;
+	std::size_t m_claimed;
+	std::size_t m_cachedTail;
+	std::atomic<std::uint64_t> m_committedBytes;
+	std::atomic<std::uint64_t> m_dropped;
+	std::atomic<std::uint64_t> m_droppedBytes;
+	std::atomic<std::uint64_t> m_overruns;
+
+	char m_padding1[CacheLineSize];
+	// written by the consumer
+	std::atomic<std::size_t> m_tail;
+	mutable std::size_t m_cachedHead;
+
+	char m_padding2[CacheLineSize];
+};
+
+}
+
+#endif
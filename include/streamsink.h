@@ -0,0 +1,67 @@
+/*
+ * This file is part of Usbpp, a C++ wrapper around libusb
+ * Copyright (C) 2016  Lukas Jirkovsky <l.jirkovsky @at@ gmail.com>
+ *
+ * Usbpp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, version 3 of the License
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBUSBPP_STREAMSINK_H_
+#define LIBUSBPP_STREAMSINK_H_
+
+#include <cstddef>
+#include <cstdint>
+
+namespace Usbpp {
+
+/**
+ * A destination of streamed data.
+ *
+ * The streaming transfers complete directly into the memory provided by
+ * the sink (e.g. the slots of a StreamRing or a memory-mapped file).
+ * A buffer is claimed before a transfer is submitted and it is committed when
+ * the transfer finishes. The buffers are always committed in the order
+ * in which they were claimed. All functions are called by a single producer
+ * thread (the event loop).
+ */
+class StreamSink {
+public:
+	virtual ~StreamSink();
+
+	/**
+	 * Claim a buffer for the next transfer.
+	 *
+	 * The size of the buffer determines the length of the transfer.
+	 *
+	 * \param size on input, the preferred size of the buffer (0 for the default
+	 *        size of the sink), on output the size of the claimed buffer
+	 * \return the buffer or nullptr if the sink is full
+	 */
+	virtual std::uint8_t* claim(std::size_t& size) = 0;
+	/**
+	 * Commit the oldest claimed buffer.
+	 *
+	 * \param length number of bytes actually stored in the buffer, may be zero
+	 *        if the transfer failed
+	 */
+	virtual void commit(std::size_t length) = 0;
+	/**
+	 * Record data that were received but discarded because the sink was full.
+	 *
+	 * \param length number of bytes discarded
+	 */
+	virtual void drop(std::size_t length) = 0;
+};
+
+}
+
+#endif
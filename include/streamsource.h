@@ -0,0 +1,59 @@
+/*
+ * This file is part of Usbpp, a C++ wrapper around libusb
+ * Copyright (C) 2016  Lukas Jirkovsky <l.jirkovsky @at@ gmail.com>
+ *
+ * Usbpp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, version 3 of the License
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBUSBPP_STREAMSOURCE_H_
+#define LIBUSBPP_STREAMSOURCE_H_
+
+#include <cstddef>
+#include <cstdint>
+
+namespace Usbpp {
+
+/**
+ * An origin of streamed data.
+ *
+ * The streaming transfers are sent directly from the memory provided by
+ * the source (e.g. a memory-mapped file). A block of data is taken before
+ * a transfer is submitted and it is released when the transfer finishes.
+ * The blocks are always released in the order in which they were taken.
+ * All functions are called by a single thread at a time (the event loop).
+ */
+class StreamSource {
+public:
+	virtual ~StreamSource();
+
+	/**
+	 * Take the next block of data to send.
+	 *
+	 * The memory must remain valid until the block is released.
+	 *
+	 * \param size on input, the preferred size of the block (0 for the default
+	 *        size of the source), on output the size of the block
+	 * \return the block or nullptr if there are no more data
+	 */
+	virtual const std::uint8_t* next(std::size_t& size) = 0;
+	/**
+	 * Release the oldest block taken.
+	 *
+	 * \param length number of bytes actually sent
+	 */
+	virtual void release(std::size_t length) = 0;
+};
+
+}
+
+#endif
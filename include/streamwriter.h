@@ -0,0 +1,121 @@
+/*
+ * This file is part of Usbpp, a C++ wrapper around libusb
+ * Copyright (C) 2016  Lukas Jirkovsky <l.jirkovsky @at@ gmail.com>
+ *
+ * Usbpp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, version 3 of the License
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBUSBPP_STREAMWRITER_H_
+#define LIBUSBPP_STREAMWRITER_H_
+
+#include <cstdint>
+#include <memory>
+
+#include "device.h"
+#include "streamsource.h"
+
+namespace Usbpp {
+
+/**
+ * Streams data from a StreamSource to a bulk or interrupt OUT endpoint.
+ *
+ * The writer keeps a number of transfers submitted on the endpoint until
+ * the source runs out of data. The transfers are sent directly from the memory
+ * of the source, so the data are never copied. When a transfer fails,
+ * no more transfers are submitted.
+ *
+ * The event loop of the device's context must be running, see
+ * Context::startEventLoop().
+ */
+class StreamWriter {
+public:
+	/**
+	 * Create a writer.
+	 *
+	 * \param device an open device with the interface of the endpoint claimed
+	 * \param endpoint address of the OUT endpoint
+	 * \param source origin of the data, it must outlive the writer
+	 * \param depth number of transfers kept submitted, it is also the maximum
+	 *        for setQueueDepth()
+	 * \param timeout timeout of each transfer in milliseconds, 0 for unlimited
+	 * \param interrupt true if the endpoint is an interrupt endpoint rather than bulk
+	 */
+	StreamWriter(const Device& device,
+	             unsigned char endpoint,
+	             StreamSource& source,
+	             unsigned int depth = 4,
+	             unsigned int timeout = 0,
+	             bool interrupt = false);
+	StreamWriter(const StreamWriter& other) = delete;
+	/**
+	 * Stops the writer.
+	 */
+	~StreamWriter();
+
+	StreamWriter& operator=(const StreamWriter& other) = delete;
+
+	/**
+	 * Start streaming.
+	 *
+	 * \throws DeviceTransferException if the transfers cannot be submitted
+	 */
+	void start();
+	/**
+	 * Wait until all data are sent or a transfer fails.
+	 *
+	 * \throws DeviceTransferException if a transfer failed
+	 */
+	void wait();
+	/**
+	 * Stop streaming.
+	 *
+	 * Cancels the submitted transfers and waits until they finish.
+	 */
+	void stop();
+	/**
+	 * Check whether any transfer is still submitted.
+	 */
+	bool isRunning() const;
+	/**
+	 * Set the preferred size of the transfers submitted from now on.
+	 *
+	 * \param size the size, 0 to use the default size of the source
+	 */
+	void setTransferSize(std::size_t size);
+	/**
+	 * Get the preferred size of the transfers, 0 if the default size of the source is used.
+	 */
+	std::size_t getTransferSize() const;
+	/**
+	 * Set the number of transfers kept submitted.
+	 *
+	 * \param depth the number, at most the depth given to the constructor
+	 */
+	void setQueueDepth(unsigned int depth);
+	/**
+	 * Get the number of transfers kept submitted.
+	 */
+	unsigned int getQueueDepth() const;
+	/**
+	 * Get the number of bytes sent.
+	 */
+	std::uint64_t getBytesSent() const;
+
+private:
+	class Impl;
+	std::unique_ptr<Impl> pimpl;
+};
+
+}
+
+#endif
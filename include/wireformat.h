@@ -0,0 +1,188 @@
+/*
+ * This file is part of Usbpp, a C++ wrapper around libusb
+ * Copyright (C) 2016  Lukas Jirkovsky <l.jirkovsky @at@ gmail.com>
+ *
+ * Usbpp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, version 3 of the License
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBUSBPP_WIREFORMAT_H_
+#define LIBUSBPP_WIREFORMAT_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "bufferview.h"
+
+namespace Usbpp {
+namespace WireFormat {
+
+/**
+ * Byte order of a field.
+ */
+enum class Endian {
+	LITTLE,
+	BIG
+};
+
+namespace Detail {
+
+template<std::size_t Size> struct Raw;
+template<> struct Raw<1> { typedef std::uint8_t type; };
+template<> struct Raw<2> { typedef std::uint16_t type; };
+template<> struct Raw<4> { typedef std::uint32_t type; };
+template<> struct Raw<8> { typedef std::uint64_t type; };
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+constexpr Endian HostEndian = Endian::BIG;
+#else
+constexpr Endian HostEndian = Endian::LITTLE;
+#endif
+
+inline std::uint8_t byteSwap(std::uint8_t value) {
+	return value;
+}
+
+inline std::uint16_t byteSwap(std::uint16_t value) {
+#ifdef __GNUC__
+	return __builtin_bswap16(value);
+#else
+	return static_cast<std::uint16_t>((value >> 8) | (value << 8));
+#endif
+}
+
+inline std::uint32_t byteSwap(std::uint32_t value) {
+#ifdef __GNUC__
+	return __builtin_bswap32(value);
+#else
+	return (value >> 24) | ((value >> 8) & 0xFF00) | ((value << 8) & 0xFF0000) | (value << 24);
+#endif
+}
+
+inline std::uint64_t byteSwap(std::uint64_t value) {
+#ifdef __GNUC__
+	return __builtin_bswap64(value);
+#else
+	return (static_cast<std::uint64_t>(byteSwap(static_cast<std::uint32_t>(value))) << 32) |
+	       byteSwap(static_cast<std::uint32_t>(value >> 32));
+#endif
+}
+
+}
+
+/**
+ * An integer field of a binary structure.
+ *
+ * Describes the position, width and byte order of a field once, so that
+ * the field can be read and written without hand-written shifts. The access
+ * compiles to a single (possibly unaligned) load or store, followed
+ * by a byte swap if the byte order differs from the host.
+ *
+ * \tparam Offset Offset of the field in bytes.
+ * \tparam T Type of the field, an integer or an enum with 1, 2, 4 or 8 bytes.
+ * \tparam E Byte order of the field.
+ */
+template<std::size_t Offset, typename T, Endian E = Endian::LITTLE>
+struct Field {
+	typedef T Type;
+	typedef typename Detail::Raw<sizeof(T)>::type Raw;
+
+	/// offset of the field in bytes
+	static constexpr std::size_t offset = Offset;
+	/// size of the field in bytes
+	static constexpr std::size_t size = sizeof(T);
+	/// offset of the first byte after the field
+	static constexpr std::size_t end = Offset + sizeof(T);
+
+	/**
+	 * Read the field.
+	 *
+	 * \param data The beginning of the structure.
+	 */
+	static T load(const std::uint8_t* data) {
+		Raw raw;
+		std::memcpy(&raw, data + Offset, sizeof(raw));
+		if (E != Detail::HostEndian) {
+			raw = Detail::byteSwap(raw);
+		}
+		return static_cast<T>(raw);
+	}
+
+	/**
+	 * Write the field.
+	 *
+	 * \param data The beginning of the structure.
+	 * \param value The value to write.
+	 */
+	static void store(std::uint8_t* data, T value) {
+		Raw raw(static_cast<Raw>(value));
+		if (E != Detail::HostEndian) {
+			raw = Detail::byteSwap(raw);
+		}
+		std::memcpy(data + Offset, &raw, sizeof(raw));
+	}
+};
+
+/**
+ * A byte array field of a binary structure.
+ *
+ * \tparam Offset Offset of the field in bytes.
+ * \tparam Length Length of the field in bytes.
+ */
+template<std::size_t Offset, std::size_t Length>
+struct Bytes {
+	/// offset of the field in bytes
+	static constexpr std::size_t offset = Offset;
+	/// size of the field in bytes
+	static constexpr std::size_t size = Length;
+	/// offset of the first byte after the field
+	static constexpr std::size_t end = Offset + Length;
+
+	/**
+	 * Get a view of the first \a length bytes of the field.
+	 *
+	 * \param data The beginning of the structure.
+	 * \param length The number of bytes to view, at most the field length.
+	 */
+	static ByteBufferView view(const std::uint8_t* data, std::size_t length = Length) {
+		return ByteBufferView(data + Offset, length < Length ? length : Length);
+	}
+
+	/**
+	 * Write the field.
+	 *
+	 * The bytes of the field not covered by \a value are zeroed.
+	 *
+	 * \param data The beginning of the structure.
+	 * \param value The bytes to write, at most the field length.
+	 */
+	static void store(std::uint8_t* data, ByteBufferView value) {
+		std::size_t length(value.size() < Length ? value.size() : Length);
+		if (length != 0) {
+			std::memcpy(data + Offset, value.data(), length);
+		}
+		std::memset(data + Offset + length, 0, Length - length);
+	}
+};
+
+template<std::size_t Offset, typename T, Endian E> constexpr std::size_t Field<Offset, T, E>::offset;
+template<std::size_t Offset, typename T, Endian E> constexpr std::size_t Field<Offset, T, E>::size;
+template<std::size_t Offset, typename T, Endian E> constexpr std::size_t Field<Offset, T, E>::end;
+template<std::size_t Offset, std::size_t Length> constexpr std::size_t Bytes<Offset, Length>::offset;
+template<std::size_t Offset, std::size_t Length> constexpr std::size_t Bytes<Offset, Length>::size;
+template<std::size_t Offset, std::size_t Length> constexpr std::size_t Bytes<Offset, Length>::end;
+
+}
+}
+
+#endif
@@ -0,0 +1,361 @@
+/*
+ * This file is part of Usbpp, a C++ wrapper around libusb
+ * Copyright (C) 2016  Lukas Jirkovsky <l.jirkovsky @at@ gmail.com>
+ *
+ * Usbpp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, version 3 of the License
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "autotuner.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <time.h>
+
+#include "streamreader.h"
+#include "streamwriter.h"
+
+namespace {
+
+/**
+ * Get the CPU time consumed by the whole process.
+ */
+std::chrono::nanoseconds processCpuTime() {
+	timespec ts;
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+	return std::chrono::seconds(ts.tv_sec) + std::chrono::nanoseconds(ts.tv_nsec);
+}
+
+// a multiple of the maximum packet size of any bulk endpoint (64, 512 or 1024 bytes)
+const std::size_t PacketMultiple = 1024;
+
+/**
+ * Round the transfer size down to a whole number of packets.
+ *
+ * A transfer that is not a multiple of the packet size may end in the middle
+ * of a packet and fail with LIBUSB_ERROR_OVERFLOW. The sizes smaller than
+ * the multiple are kept as they are.
+ */
+std::size_t roundToPackets(std::size_t size) {
+	return size >= PacketMultiple ? size - size % PacketMultiple : size;
+}
+
+/**
+ * Bytes transferred per CPU second, the value the tuner maximizes.
+ */
+double score(const Usbpp::AutoTunerMeasurement& measurement) {
+	// an idle CPU is not measurable, treat it as a very small load
+	return measurement.throughput / std::max(measurement.cpuLoad, 1e-6);
+}
+
+}
+
+namespace Usbpp {
+
+AutoTunerOptions::AutoTunerOptions() :
+	minTransferSize(4096),
+	maxTransferSize(1 << 20),
+	initialTransferSize(0),
+	initialDepth(0),
+	settleTime(100),
+	measureTime(500),
+	threshold(0.03),
+	throughputTolerance(0.05) {
+
+}
+
+class AutoTuner::Impl {
+public:
+	Impl(const AutoTunerOptions& options, std::size_t maxTransferSize, unsigned int maxDepth);
+
+	/**
+	 * Tuning thread
+	 */
+	void run();
+	/**
+	 * Apply a configuration and measure it
+	 *
+	 * \return false if the tuning was stopped in the meantime
+	 */
+	bool measure(std::size_t transferSize, unsigned int depth, AutoTunerMeasurement& result);
+	/**
+	 * Sleep unless the tuning is stopped
+	 *
+	 * \return false if the tuning was stopped
+	 */
+	bool sleep(std::chrono::milliseconds duration);
+	/**
+	 * Apply a configuration to the stream
+	 */
+	void apply(std::size_t transferSize, unsigned int depth);
+	/**
+	 * Stop the tuning thread
+	 */
+	void join();
+
+	AutoTunerOptions m_options;
+	std::size_t m_maxTransferSize;
+	unsigned int m_maxDepth;
+	// access to the tuned stream
+	std::function<void(std::size_t)> m_setTransferSize;
+	std::function<void(unsigned int)> m_setDepth;
+	std::function<std::size_t()> m_getTransferSize;
+	std::function<unsigned int()> m_getDepth;
+	std::function<std::uint64_t()> m_getBytes;
+
+	std::thread m_thread;
+	mutable std::mutex m_mutex;
+	std::condition_variable m_wake;
+	bool m_stopRequested;
+	std::atomic<bool> m_converged;
+	AutoTunerMeasurement m_best;
+};
+
+AutoTuner::Impl::Impl(const AutoTunerOptions& options, std::size_t maxTransferSize, unsigned int maxDepth) :
+	m_options(options),
+	m_maxTransferSize(roundToPackets(std::max(maxTransferSize, std::size_t(1)))),
+	m_maxDepth(std::max(maxDepth, 1u)),
+	m_stopRequested(false),
+	m_converged(false) {
+
+	m_options.minTransferSize = std::min(std::max(m_options.minTransferSize, PacketMultiple), m_maxTransferSize);
+	m_options.minTransferSize = roundToPackets(m_options.minTransferSize);
+	m_best.transferSize = 0;
+	m_best.depth = 0;
+	m_best.throughput = 0;
+	m_best.cpuLoad = 0;
+}
+
+void AutoTuner::Impl::run() {
+	std::size_t transferSize(m_options.initialTransferSize != 0 ? m_options.initialTransferSize : m_getTransferSize());
+	unsigned int depth(m_options.initialDepth != 0 ? m_options.initialDepth : m_getDepth());
+	if (transferSize == 0) {
+		// the stream uses its default size, which is unknown, start from the largest
+		transferSize = m_maxTransferSize;
+	}
+	transferSize = roundToPackets(std::min(std::max(transferSize, m_options.minTransferSize), m_maxTransferSize));
+	depth = std::min(std::max(depth, 1u), m_maxDepth);
+
+	AutoTunerMeasurement current;
+	if (!measure(transferSize, depth, current)) {
+		return;
+	}
+	double maxThroughput(current.throughput);
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_best = current;
+	}
+
+	while (true) {
+		std::vector<std::pair<std::size_t, unsigned int>> candidates;
+		if (transferSize < m_maxTransferSize) {
+			candidates.push_back(std::make_pair(std::min(transferSize * 2, m_maxTransferSize), depth));
+		}
+		if (transferSize > m_options.minTransferSize) {
+			candidates.push_back(std::make_pair(std::max(roundToPackets(transferSize / 2), m_options.minTransferSize), depth));
+		}
+		if (depth < m_maxDepth) {
+			candidates.push_back(std::make_pair(transferSize, depth + 1));
+		}
+		if (depth > 1) {
+			candidates.push_back(std::make_pair(transferSize, depth - 1));
+		}
+
+		std::vector<AutoTunerMeasurement> results;
+		for (const std::pair<std::size_t, unsigned int>& candidate : candidates) {
+			AutoTunerMeasurement result;
+			if (!measure(candidate.first, candidate.second, result)) {
+				return;
+			}
+			maxThroughput = std::max(maxThroughput, result.throughput);
+			results.push_back(result);
+		}
+		// measure the current configuration again, the conditions may have changed
+		if (!measure(transferSize, depth, current)) {
+			return;
+		}
+		maxThroughput = std::max(maxThroughput, current.throughput);
+
+		// only the configurations close to the best throughput are acceptable
+		const double minThroughput((1.0 - m_options.throughputTolerance) * maxThroughput);
+		const AutoTunerMeasurement* best(nullptr);
+		for (const AutoTunerMeasurement& result : results) {
+			if (result.throughput >= minThroughput && (best == nullptr || score(result) > score(*best))) {
+				best = &result;
+			}
+		}
+
+		bool currentAcceptable(current.throughput >= minThroughput);
+		if (best == nullptr ||
+		    (currentAcceptable && score(*best) <= score(current) * (1.0 + m_options.threshold))) {
+			break;
+		}
+		transferSize = best->transferSize;
+		depth = best->depth;
+		current = *best;
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_best = current;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_best = current;
+	}
+	apply(transferSize, depth);
+	m_converged = true;
+}
+
+bool AutoTuner::Impl::measure(std::size_t transferSize, unsigned int depth, AutoTunerMeasurement& result) {
+	apply(transferSize, depth);
+	if (!sleep(m_options.settleTime)) {
+		return false;
+	}
+
+	std::uint64_t bytesStart(m_getBytes());
+	std::chrono::nanoseconds cpuStart(processCpuTime());
+	std::chrono::steady_clock::time_point start(std::chrono::steady_clock::now());
+	if (!sleep(m_options.measureTime)) {
+		return false;
+	}
+	std::uint64_t bytes(m_getBytes() - bytesStart);
+	std::chrono::nanoseconds cpu(processCpuTime() - cpuStart);
+	std::chrono::duration<double> elapsed(std::chrono::steady_clock::now() - start);
+
+	result.transferSize = transferSize;
+	result.depth = depth;
+	result.throughput = bytes / elapsed.count();
+	result.cpuLoad = std::chrono::duration<double>(cpu).count() / elapsed.count();
+	return true;
+}
+
+bool AutoTuner::Impl::sleep(std::chrono::milliseconds duration) {
+	std::unique_lock<std::mutex> lock(m_mutex);
+	return !m_wake.wait_for(lock, duration, [this]() {
+		return m_stopRequested;
+	});
+}
+
+void AutoTuner::Impl::apply(std::size_t transferSize, unsigned int depth) {
+	m_setTransferSize(transferSize);
+	m_setDepth(depth);
+}
+
+void AutoTuner::Impl::join() {
+	if (!m_thread.joinable()) {
+		return;
+	}
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stopRequested = true;
+	}
+	m_wake.notify_all();
+	m_thread.join();
+}
+
+AutoTuner::AutoTuner(StreamReader& reader, const AutoTunerOptions& options) :
+	pimpl(new Impl(options, std::min(options.maxTransferSize, reader.getTransferSize()), reader.getQueueDepth())) {
+
+	StreamReader* stream(&reader);
+	pimpl->m_setTransferSize = [stream](std::size_t size) {
+		stream->setTransferSize(size);
+	};
+	pimpl->m_setDepth = [stream](unsigned int depth) {
+		stream->setQueueDepth(depth);
+	};
+	pimpl->m_getTransferSize = [stream]() {
+		return stream->getTransferSize();
+	};
+	pimpl->m_getDepth = [stream]() {
+		return stream->getQueueDepth();
+	};
+	pimpl->m_getBytes = [stream]() {
+		return stream->getBytesReceived();
+	};
+}
+
+AutoTuner::AutoTuner(StreamWriter& writer, const AutoTunerOptions& options) :
+	pimpl(new Impl(options, options.maxTransferSize, writer.getQueueDepth())) {
+
+	StreamWriter* stream(&writer);
+	pimpl->m_setTransferSize = [stream](std::size_t size) {
+		stream->setTransferSize(size);
+	};
+	pimpl->m_setDepth = [stream](unsigned int depth) {
+		stream->setQueueDepth(depth);
+	};
+	pimpl->m_getTransferSize = [stream]() {
+		return stream->getTransferSize();
+	};
+	pimpl->m_getDepth = [stream]() {
+		return stream->getQueueDepth();
+	};
+	pimpl->m_getBytes = [stream]() {
+		return stream->getBytesSent();
+	};
+}
+
+AutoTuner::~AutoTuner() {
+	pimpl->join();
+}
+
+void AutoTuner::start() {
+	if (pimpl->m_thread.joinable()) {
+		return;
+	}
+	pimpl->m_stopRequested = false;
+	pimpl->m_converged = false;
+	pimpl->m_thread = std::thread(&Impl::run, pimpl.get());
+}
+
+void AutoTuner::stop() {
+	pimpl->join();
+	AutoTunerMeasurement best(getBest());
+	if (best.depth != 0) {
+		pimpl->apply(best.transferSize, best.depth);
+	}
+}
+
+void AutoTuner::pin(std::size_t transferSize, unsigned int depth) {
+	pimpl->join();
+	pimpl->apply(transferSize, depth);
+	std::lock_guard<std::mutex> lock(pimpl->m_mutex);
+	pimpl->m_best.transferSize = transferSize;
+	pimpl->m_best.depth = depth;
+	pimpl->m_best.throughput = 0;
+	pimpl->m_best.cpuLoad = 0;
+	pimpl->m_converged = true;
+}
+
+bool AutoTuner::isConverged() const {
+	return pimpl->m_converged;
+}
+
+std::size_t AutoTuner::getTransferSize() const {
+	return getBest().transferSize;
+}
+
+unsigned int AutoTuner::getDepth() const {
+	return getBest().depth;
+}
+
+AutoTunerMeasurement AutoTuner::getBest() const {
+	std::lock_guard<std::mutex> lock(pimpl->m_mutex);
+	return pimpl->m_best;
+}
+
+}
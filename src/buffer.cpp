@@ -21,76 +21,101 @@
 #include <cstdlib>
 #include <cstring>
 #include <new>
+#include <sys/mman.h>
+#include <utility>
+
+#include "bufferpool.h"
 
 namespace Usbpp {
 
+const std::size_t ByteBuffer::InlineSize;
+const std::size_t ByteBuffer::HugePageSize;
+
 ByteBuffer::ByteBuffer()
-	: m_data(nullptr), m_size(0) {
+	: m_data(m_inline), m_size(0), m_capacity(InlineSize), m_pool(nullptr), m_alignment(0), m_hugePages(false) {
 
 }
 
 ByteBuffer::ByteBuffer(std::size_t size)
-	: m_size(size) {
-	m_data = static_cast<std::uint8_t*>(malloc(size * sizeof(std::uint8_t)));
-	if (m_data == nullptr) {
-		throw std::bad_alloc();
-	}
+	: m_data(nullptr), m_size(size), m_capacity(size), m_pool(nullptr), m_alignment(0), m_hugePages(false) {
+	m_data = allocate(m_capacity);
+}
+
+ByteBuffer::ByteBuffer(std::size_t size, BufferPool& pool)
+	: m_data(nullptr), m_size(size), m_capacity(size), m_pool(&pool), m_alignment(0), m_hugePages(false) {
+	m_data = allocate(m_capacity);
+}
+
+ByteBuffer::ByteBuffer(std::size_t size, std::size_t alignment, bool hugePages)
+	: m_data(nullptr), m_size(size), m_capacity(size), m_pool(nullptr),
+	  m_alignment(alignment > alignof(std::max_align_t) ? alignment : 0), m_hugePages(hugePages) {
+	m_data = allocate(m_capacity);
 }
 
 ByteBuffer::ByteBuffer(const std::uint8_t* data_, std::size_t size)
-	: m_size(size) {
-	m_data = static_cast<std::uint8_t*>(malloc(size * sizeof(std::uint8_t)));
-	if (m_data == nullptr) {
-		throw std::bad_alloc();
-	}
+	: m_data(nullptr), m_size(size), m_capacity(size), m_pool(nullptr), m_alignment(0), m_hugePages(false) {
+	m_data = allocate(m_capacity);
 	std::memcpy(m_data, data_, size * sizeof(std::uint8_t));
 }
 
 ByteBuffer::ByteBuffer(const ByteBuffer& other)
-	:m_size(other.m_size) {
-	m_data = static_cast<std::uint8_t*>(malloc(other.m_size * sizeof(std::uint8_t)));
-	if (m_data == nullptr) {
-		throw std::bad_alloc();
-	}
+	: m_data(nullptr), m_size(other.m_size), m_capacity(other.m_size), m_pool(other.m_pool),
+	  m_alignment(other.m_alignment), m_hugePages(other.m_hugePages) {
+	m_data = allocate(m_capacity);
 	std::memcpy(m_data, other.m_data, other.m_size * sizeof(std::uint8_t));
 }
 
 ByteBuffer::ByteBuffer(ByteBuffer&& other) noexcept
-	: m_data(other.m_data), m_size(other.m_size) {
-	other.m_data = nullptr;
+	: m_data(other.m_data), m_size(other.m_size), m_capacity(other.m_capacity), m_pool(other.m_pool),
+	  m_alignment(other.m_alignment), m_hugePages(other.m_hugePages) {
+	if (other.isInline()) {
+		// inline data cannot be stolen
+		m_data = m_inline;
+		std::memcpy(m_inline, other.m_inline, m_size);
+	}
+	other.m_data = other.m_inline;
 	other.m_size = 0;
+	other.m_capacity = other.inlineCapacity();
 }
 
 ByteBuffer::~ByteBuffer() {
-	if (m_data) {
-		free(m_data);
-		m_data = nullptr;
-		m_size = 0;
-	}
+	deallocate();
 }
 
 ByteBuffer& ByteBuffer::operator=(const ByteBuffer& other) {
 	if (this != &other) {
-		if (m_size == other.m_size) {
-			std::memcpy(m_data, other.m_data, m_size);
-			return *this;
+		if (other.m_size > m_capacity) {
+			// keep the allocation policy of this buffer
+			std::size_t capacity_(other.m_size);
+			std::uint8_t* tmp(allocate(capacity_));
+			deallocate();
+			m_data = tmp;
+			m_capacity = capacity_;
 		}
-		ByteBuffer tmp(other);
-		std::swap(m_data, tmp.m_data);
-		std::swap(m_size, tmp.m_size);
+		std::memcpy(m_data, other.m_data, other.m_size);
+		m_size = other.m_size;
 	}
 	return *this;
 }
 
 ByteBuffer& ByteBuffer::operator=(ByteBuffer&& other) noexcept {
 	if (this != &other) {
-		if (m_data) {
-			free(m_data);
-		}
-		m_data = other.m_data;
+		deallocate();
 		m_size = other.m_size;
-		other.m_data = nullptr;
+		m_capacity = other.m_capacity;
+		m_pool = other.m_pool;
+		m_alignment = other.m_alignment;
+		m_hugePages = other.m_hugePages;
+		if (other.isInline()) {
+			m_data = m_inline;
+			std::memcpy(m_inline, other.m_inline, m_size);
+		}
+		else {
+			m_data = other.m_data;
+		}
+		other.m_data = other.m_inline;
 		other.m_size = 0;
+		other.m_capacity = other.inlineCapacity();
 	}
 	return *this;
 }
@@ -104,31 +129,56 @@ const std::uint8_t& ByteBuffer::operator[](std::size_t i) const {
 }
 
 ByteBuffer& ByteBuffer::append(const ByteBuffer& other) {
-	std::uint8_t* tmp(static_cast<std::uint8_t*>(realloc(m_data, m_size + other.m_size)));
-	if (tmp == nullptr) {
-		throw std::bad_alloc();
-	}
-	// copy the contents
-	memcpy(tmp + m_size, other.m_data, other.m_size);
-	// update the current buffer
-	m_data = tmp;
-	m_size += other.m_size;
+	std::size_t offset(m_size);
+	// resize first, other may be this buffer
+	resize(m_size + other.m_size);
+	std::memcpy(m_data + offset, other.m_data, m_size - offset);
 
 	return *this;
 }
 
 void ByteBuffer::resize(std::size_t size) {
-	if (size == m_size) {
-		return;
+	if (size > m_capacity) {
+		// grow geometrically to make the repeated growth amortized constant
+		reallocate(std::max(size, m_capacity + m_capacity / 2));
 	}
-	std::uint8_t* tmp(static_cast<std::uint8_t*>(realloc(m_data, size)));
-	if (tmp == nullptr) {
-		throw std::bad_alloc();
-	}
-	m_data = tmp;
 	m_size = size;
 }
 
+void ByteBuffer::reserve(std::size_t capacity_) {
+	if (capacity_ > m_capacity) {
+		reallocate(capacity_);
+	}
+}
+
+void ByteBuffer::shrink_to_fit() {
+	if (! isInline() && m_capacity > m_size) {
+		reallocate(m_size);
+	}
+}
+
+std::size_t ByteBuffer::capacity() const {
+	return m_capacity;
+}
+
+BufferPool* ByteBuffer::getPool() const {
+	return m_pool;
+}
+
+std::size_t ByteBuffer::getAlignment() const {
+	if (m_pool != nullptr) {
+		return m_pool->getAlignment();
+	}
+	if (m_hugePages) {
+		return std::max(m_alignment, HugePageSize);
+	}
+	return m_alignment != 0 ? m_alignment : alignof(std::max_align_t);
+}
+
+bool ByteBuffer::getHugePages() const {
+	return m_hugePages;
+}
+
 std::size_t ByteBuffer::size() const {
 	return m_size;
 }
@@ -141,4 +191,83 @@ const std::uint8_t* ByteBuffer::data() const {
 	return m_data;
 }
 
+std::uint8_t* ByteBuffer::allocate(std::size_t& capacity_) {
+	if (capacity_ == 0 || capacity_ <= inlineCapacity()) {
+		capacity_ = inlineCapacity();
+		return m_inline;
+	}
+	if (m_pool != nullptr) {
+		return m_pool->allocate(capacity_);
+	}
+	if (m_alignment == 0 && ! m_hugePages) {
+		std::uint8_t* data_(static_cast<std::uint8_t*>(malloc(capacity_ * sizeof(std::uint8_t))));
+		if (data_ == nullptr) {
+			throw std::bad_alloc();
+		}
+		return data_;
+	}
+
+	std::size_t alignment(m_alignment);
+	if (m_hugePages) {
+		alignment = std::max(alignment, HugePageSize);
+		capacity_ = (capacity_ + HugePageSize - 1) / HugePageSize * HugePageSize;
+	}
+	void* data_(nullptr);
+	if (posix_memalign(&data_, alignment, capacity_) != 0) {
+		throw std::bad_alloc();
+	}
+#ifdef MADV_HUGEPAGE
+	if (m_hugePages) {
+		// just a hint, the allocation works without huge pages too
+		madvise(data_, capacity_, MADV_HUGEPAGE);
+	}
+#endif
+	return static_cast<std::uint8_t*>(data_);
+}
+
+void ByteBuffer::reallocate(std::size_t capacity_) {
+	if (isInline() && capacity_ <= inlineCapacity()) {
+		return;
+	}
+	if (! isInline() && capacity_ > inlineCapacity() && m_pool == nullptr && m_alignment == 0 && ! m_hugePages) {
+		std::uint8_t* tmp(static_cast<std::uint8_t*>(realloc(m_data, capacity_)));
+		if (tmp == nullptr) {
+			throw std::bad_alloc();
+		}
+		m_data = tmp;
+		m_capacity = capacity_;
+		return;
+	}
+	std::uint8_t* tmp(allocate(capacity_));
+	std::memcpy(tmp, m_data, m_size);
+	deallocate();
+	m_data = tmp;
+	m_capacity = capacity_;
+}
+
+void ByteBuffer::deallocate() {
+	if (! isInline()) {
+		if (m_pool != nullptr) {
+			m_pool->deallocate(m_data, m_capacity);
+		}
+		else {
+			free(m_data);
+		}
+		m_data = m_inline;
+		m_capacity = inlineCapacity();
+	}
+}
+
+bool ByteBuffer::isInline() const {
+	return m_data == m_inline;
+}
+
+std::size_t ByteBuffer::inlineCapacity() const {
+	if (m_pool != nullptr) {
+		// the inline storage cannot honour the alignment of a page-aligned pool
+		return m_pool->getAlignment() <= alignof(std::max_align_t) ? InlineSize : 0;
+	}
+	return (m_alignment == 0 && ! m_hugePages) ? InlineSize : 0;
+}
+
 }
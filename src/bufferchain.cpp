@@ -0,0 +1,169 @@
+/*
+ * This file is part of Usbpp, a C++ wrapper around libusb
+ * Copyright (C) 2016  Lukas Jirkovsky <l.jirkovsky @at@ gmail.com>
+ *
+ * Usbpp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, version 3 of the License
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "bufferchain.h"
+
+#include <cstring>
+#include <utility>
+
+namespace Usbpp {
+
+BufferChain::BufferChain() : m_size(0) {
+
+}
+
+BufferChain::BufferChain(const SharedBuffer& segment) : m_size(0) {
+	append(segment);
+}
+
+BufferChain::BufferChain(const BufferChain& other) :
+	m_segments(other.m_segments),
+	m_size(other.m_size) {
+
+}
+
+BufferChain::BufferChain(BufferChain&& other) noexcept :
+	m_segments(std::move(other.m_segments)),
+	m_size(other.m_size) {
+	other.m_segments.clear();
+	other.m_size = 0;
+}
+
+BufferChain::~BufferChain() {
+
+}
+
+BufferChain& BufferChain::operator=(const BufferChain& other) {
+	if (this != &other) {
+		m_segments = other.m_segments;
+		m_size = other.m_size;
+	}
+	return *this;
+}
+
+BufferChain& BufferChain::operator=(BufferChain&& other) noexcept {
+	if (this != &other) {
+		m_segments = std::move(other.m_segments);
+		m_size = other.m_size;
+		other.m_segments.clear();
+		other.m_size = 0;
+	}
+	return *this;
+}
+
+BufferChain& BufferChain::append(const SharedBuffer& segment) {
+	if (! segment.empty()) {
+		m_segments.push_back(segment);
+		m_size += segment.size();
+	}
+	return *this;
+}
+
+BufferChain& BufferChain::append(const BufferChain& other) {
+	// copy first, other may be this chain
+	std::deque<SharedBuffer> segments(other.m_segments);
+	m_segments.insert(m_segments.end(), segments.begin(), segments.end());
+	m_size += other.m_size;
+	return *this;
+}
+
+BufferChain& BufferChain::prepend(const SharedBuffer& segment) {
+	if (! segment.empty()) {
+		m_segments.push_front(segment);
+		m_size += segment.size();
+	}
+	return *this;
+}
+
+BufferChain& BufferChain::prepend(const BufferChain& other) {
+	std::deque<SharedBuffer> segments(other.m_segments);
+	m_segments.insert(m_segments.begin(), segments.begin(), segments.end());
+	m_size += other.m_size;
+	return *this;
+}
+
+BufferChain BufferChain::split(std::size_t offset) {
+	BufferChain tail;
+	if (offset >= m_size) {
+		return tail;
+	}
+
+	// find the segment containing the split point
+	std::size_t i(0);
+	std::size_t position(0);
+	while (position + m_segments[i].size() <= offset) {
+		position += m_segments[i].size();
+		i++;
+	}
+	if (position < offset) {
+		SharedBuffer& segment(m_segments[i]);
+		tail.append(segment.slice(offset - position, segment.size()));
+		segment = segment.slice(0, offset - position);
+		i++;
+	}
+	for (std::size_t j = i; j < m_segments.size(); j++) {
+		tail.append(m_segments[j]);
+	}
+	m_segments.erase(m_segments.begin() + i, m_segments.end());
+	m_size = offset;
+	return tail;
+}
+
+ByteBufferView BufferChain::linearize() {
+	if (m_segments.size() > 1) {
+		SharedBuffer whole(toBuffer());
+		m_segments.clear();
+		m_segments.push_back(whole);
+	}
+	if (m_segments.empty()) {
+		return ByteBufferView();
+	}
+	return m_segments.front().view();
+}
+
+ByteBuffer BufferChain::toBuffer() const {
+	ByteBuffer result(m_size);
+	std::size_t position(0);
+	for (const SharedBuffer& segment : m_segments) {
+		std::memcpy(result.data() + position, segment.data(), segment.size());
+		position += segment.size();
+	}
+	return result;
+}
+
+void BufferChain::clear() {
+	m_segments.clear();
+	m_size = 0;
+}
+
+std::size_t BufferChain::size() const {
+	return m_size;
+}
+
+bool BufferChain::empty() const {
+	return m_size == 0;
+}
+
+std::size_t BufferChain::getSegmentCount() const {
+	return m_segments.size();
+}
+
+const SharedBuffer& BufferChain::getSegment(std::size_t i) const {
+	return m_segments[i];
+}
+
+}
@@ -0,0 +1,267 @@
+/*
+ * This file is part of Usbpp, a C++ wrapper around libusb
+ * Copyright (C) 2016  Lukas Jirkovsky <l.jirkovsky @at@ gmail.com>
+ *
+ * Usbpp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, version 3 of the License
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "bufferpool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <mutex>
+#include <new>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+// the smallest class holds 128 bytes, anything smaller is stored inline by ByteBuffer
+const std::size_t MinClassShift = 7;
+const std::size_t ClassCount = 16;
+
+/**
+ * Get the size class of a block of \a size bytes.
+ */
+std::size_t sizeClass(std::size_t size) {
+	std::size_t cls(0);
+	while ((std::size_t(1) << (cls + MinClassShift)) < size) {
+		cls++;
+	}
+	return cls;
+}
+
+/**
+ * Get the size of blocks of a class.
+ */
+std::size_t classSize(std::size_t cls) {
+	return std::size_t(1) << (cls + MinClassShift);
+}
+
+/**
+ * Get the number of free blocks of a class kept by each thread.
+ */
+std::size_t cacheLimit(std::size_t cls) {
+	return std::max<std::size_t>(2, std::min<std::size_t>(64, (1 << 20) / classSize(cls)));
+}
+
+/**
+ * State of a pool shared by the pool and the thread caches.
+ */
+struct PoolState {
+	PoolState(std::uint64_t id_, std::size_t alignment_) :
+		id(id_),
+		alignment(alignment_),
+		alive(true),
+		allocations(0),
+		deallocations(0),
+		systemAllocations(0),
+		systemDeallocations(0) {
+
+	}
+
+	~PoolState() {
+		for (std::vector<std::uint8_t*>& list : lists) {
+			for (std::uint8_t* block : list) {
+				free(block);
+			}
+		}
+	}
+
+	std::uint8_t* allocateSystem(std::size_t size) {
+		void* block(nullptr);
+		if (alignment != 0) {
+			if (posix_memalign(&block, alignment, size) != 0) {
+				block = nullptr;
+			}
+		}
+		else {
+			block = malloc(size);
+		}
+		if (block == nullptr) {
+			throw std::bad_alloc();
+		}
+		systemAllocations.fetch_add(1, std::memory_order_relaxed);
+		return static_cast<std::uint8_t*>(block);
+	}
+
+	void deallocateSystem(std::uint8_t* block) {
+		free(block);
+		systemDeallocations.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	const std::uint64_t id;
+	// 0 for the default malloc alignment
+	const std::size_t alignment;
+	std::atomic<bool> alive;
+
+	std::mutex mutex;
+	std::vector<std::uint8_t*> lists[ClassCount];
+
+	std::atomic<std::uint64_t> allocations;
+	std::atomic<std::uint64_t> deallocations;
+	std::atomic<std::uint64_t> systemAllocations;
+	std::atomic<std::uint64_t> systemDeallocations;
+};
+
+/**
+ * Free blocks of one pool cached by a thread.
+ */
+struct ThreadCache {
+	explicit ThreadCache(const std::shared_ptr<PoolState>& state_) : state(state_) {
+
+	}
+
+	~ThreadCache() {
+		flush();
+	}
+
+	/**
+	 * Move all the cached blocks to the shared free lists.
+	 */
+	void flush() {
+		std::lock_guard<std::mutex> lock(state->mutex);
+		for (std::size_t cls = 0; cls < ClassCount; cls++) {
+			state->lists[cls].insert(state->lists[cls].end(), lists[cls].begin(), lists[cls].end());
+			lists[cls].clear();
+		}
+	}
+
+	std::shared_ptr<PoolState> state;
+	std::vector<std::uint8_t*> lists[ClassCount];
+};
+
+std::atomic<std::uint64_t> s_nextPoolId(0);
+
+/**
+ * Get the cache of the calling thread for a pool.
+ */
+ThreadCache& threadCache(const std::shared_ptr<PoolState>& state) {
+	thread_local std::vector<std::unique_ptr<ThreadCache>> caches;
+	for (std::unique_ptr<ThreadCache>& cache : caches) {
+		if (cache->state->id == state->id) {
+			return *cache;
+		}
+	}
+	// drop the caches of the destroyed pools before adding a new one
+	caches.erase(std::remove_if(caches.begin(), caches.end(), [](const std::unique_ptr<ThreadCache>& cache) {
+		return ! cache->state->alive.load(std::memory_order_relaxed);
+	}), caches.end());
+	caches.push_back(std::unique_ptr<ThreadCache>(new ThreadCache(state)));
+	return *caches.back();
+}
+
+}
+
+namespace Usbpp {
+
+const std::size_t BufferPool::MaxPooledSize;
+
+class BufferPool::Impl {
+public:
+	explicit Impl(std::size_t alignment) :
+		m_state(std::make_shared<PoolState>(s_nextPoolId.fetch_add(1), alignment)) {
+
+	}
+
+	~Impl() {
+		m_state->alive.store(false, std::memory_order_relaxed);
+	}
+
+	std::shared_ptr<PoolState> m_state;
+};
+
+BufferPool::BufferPool(bool pageAligned) :
+	pimpl(new Impl(pageAligned ? sysconf(_SC_PAGESIZE) : 0)) {
+
+}
+
+BufferPool::~BufferPool() {
+
+}
+
+std::uint8_t* BufferPool::allocate(std::size_t& size) {
+	PoolState& state(*pimpl->m_state);
+	state.allocations.fetch_add(1, std::memory_order_relaxed);
+	if (size > MaxPooledSize) {
+		return state.allocateSystem(size);
+	}
+
+	std::size_t cls(sizeClass(size));
+	size = classSize(cls);
+	std::vector<std::uint8_t*>& cached(threadCache(pimpl->m_state).lists[cls]);
+	if (cached.empty()) {
+		// refill half of the thread cache from the shared list
+		std::lock_guard<std::mutex> lock(state.mutex);
+		std::vector<std::uint8_t*>& shared(state.lists[cls]);
+		std::size_t count(std::min(shared.size(), cacheLimit(cls) / 2));
+		cached.insert(cached.end(), shared.end() - count, shared.end());
+		shared.resize(shared.size() - count);
+	}
+	if (cached.empty()) {
+		return state.allocateSystem(size);
+	}
+	std::uint8_t* block(cached.back());
+	cached.pop_back();
+	return block;
+}
+
+void BufferPool::deallocate(std::uint8_t* data, std::size_t size) {
+	PoolState& state(*pimpl->m_state);
+	state.deallocations.fetch_add(1, std::memory_order_relaxed);
+	if (size > MaxPooledSize) {
+		state.deallocateSystem(data);
+		return;
+	}
+
+	std::size_t cls(sizeClass(size));
+	std::vector<std::uint8_t*>& cached(threadCache(pimpl->m_state).lists[cls]);
+	if (cached.size() >= cacheLimit(cls)) {
+		// move half of the thread cache to the shared list
+		std::size_t count(cached.size() / 2);
+		std::lock_guard<std::mutex> lock(state.mutex);
+		state.lists[cls].insert(state.lists[cls].end(), cached.end() - count, cached.end());
+		cached.resize(cached.size() - count);
+	}
+	cached.push_back(data);
+}
+
+void BufferPool::trim() {
+	PoolState& state(*pimpl->m_state);
+	threadCache(pimpl->m_state).flush();
+	std::lock_guard<std::mutex> lock(state.mutex);
+	for (std::vector<std::uint8_t*>& list : state.lists) {
+		for (std::uint8_t* block : list) {
+			state.deallocateSystem(block);
+		}
+		list.clear();
+		list.shrink_to_fit();
+	}
+}
+
+std::size_t BufferPool::getAlignment() const {
+	return pimpl->m_state->alignment != 0 ? pimpl->m_state->alignment : alignof(std::max_align_t);
+}
+
+BufferPoolStatistics BufferPool::getStatistics() const {
+	const PoolState& state(*pimpl->m_state);
+	BufferPoolStatistics statistics;
+	statistics.allocations = state.allocations.load(std::memory_order_relaxed);
+	statistics.deallocations = state.deallocations.load(std::memory_order_relaxed);
+	statistics.systemAllocations = state.systemAllocations.load(std::memory_order_relaxed);
+	statistics.systemDeallocations = state.systemDeallocations.load(std::memory_order_relaxed);
+	return statistics;
+}
+
+}
@@ -0,0 +1,87 @@
+/*
+ * This file is part of Usbpp, a C++ wrapper around libusb
+ * Copyright (C) 2016  Lukas Jirkovsky <l.jirkovsky @at@ gmail.com>
+ *
+ * Usbpp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, version 3 of the License
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "completionqueue.h"
+
+namespace {
+thread_local Usbpp::CompletionQueue* currentQueue = nullptr;
+}
+
+namespace Usbpp {
+
+CompletionQueue::CompletionQueue() {
+
+}
+
+void CompletionQueue::push(std::uintptr_t key, std::function<void()>&& func) {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	std::deque<std::function<void()>>& pending(m_pending[key]);
+	if (pending.empty() && m_running.find(key) == m_running.end()) {
+		m_ready.push_back(key);
+	}
+	pending.push_back(std::move(func));
+}
+
+bool CompletionQueue::runOne() {
+	std::uintptr_t key;
+	std::deque<std::function<void()>> funcs;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (m_ready.empty()) {
+			return false;
+		}
+		key = m_ready.front();
+		m_ready.pop_front();
+		m_running.insert(key);
+		std::swap(funcs, m_pending[key]);
+	}
+
+	for (std::function<void()>& func : funcs) {
+		func();
+	}
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_running.erase(key);
+	std::unordered_map<std::uintptr_t, std::deque<std::function<void()>>>::iterator it(m_pending.find(key));
+	if (it->second.empty()) {
+		m_pending.erase(it);
+	}
+	else {
+		// callbacks queued while running
+		m_ready.push_back(key);
+	}
+	return true;
+}
+
+bool CompletionQueue::hasPending() {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return !m_ready.empty();
+}
+
+CompletionQueue* CompletionQueue::current() {
+	return currentQueue;
+}
+
+void CompletionQueue::setCurrent(CompletionQueue* queue) {
+	currentQueue = queue;
+}
+
+std::uintptr_t CompletionQueue::makeKey(const void* handle, unsigned char endpoint) {
+	return (reinterpret_cast<std::uintptr_t>(handle) << 8) | endpoint;
+}
+
+}
@@ -0,0 +1,85 @@
+/*
+ * This file is part of Usbpp, a C++ wrapper around libusb
+ * Copyright (C) 2016  Lukas Jirkovsky <l.jirkovsky @at@ gmail.com>
+ *
+ * Usbpp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, version 3 of the License
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBUSBPP_COMPLETIONQUEUE_H_
+#define LIBUSBPP_COMPLETIONQUEUE_H_
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace Usbpp {
+
+/**
+ * A queue of transfer completion callbacks.
+ *
+ * The queue is used by the event loop threads of a context to run the
+ * completion callbacks outside of the libusb event handling. The callbacks
+ * are grouped by a key (one key per endpoint). Callbacks with the same key
+ * run in the order in which they were queued and never concurrently, callbacks
+ * with different keys can run in parallel.
+ */
+class CompletionQueue {
+public:
+	CompletionQueue();
+
+	/**
+	 * Queue a callback.
+	 */
+	void push(std::uintptr_t key, std::function<void()>&& func);
+	/**
+	 * Run all queued callbacks of one key.
+	 *
+	 * \return false if there was nothing to run
+	 */
+	bool runOne();
+	/**
+	 * Check whether there are callbacks waiting to be run.
+	 */
+	bool hasPending();
+
+	/**
+	 * Get the queue used by the event handler running in the current thread.
+	 *
+	 * \return the queue or nullptr if the callbacks should be run immediately.
+	 */
+	static CompletionQueue* current();
+	/**
+	 * Set the queue used by the event handler running in the current thread.
+	 */
+	static void setCurrent(CompletionQueue* queue);
+
+	/**
+	 * Build the key for an endpoint of an open device.
+	 */
+	static std::uintptr_t makeKey(const void* handle, unsigned char endpoint);
+
+private:
+	std::mutex m_mutex;
+	std::unordered_map<std::uintptr_t, std::deque<std::function<void()>>> m_pending;
+	// keys with pending callbacks that aren't being run by any thread
+	std::deque<std::uintptr_t> m_ready;
+	// keys whose callbacks are being run
+	std::unordered_set<std::uintptr_t> m_running;
+};
+
+}
+
+#endif
@@ -17,13 +17,261 @@
 
 #include "context.h"
 
+#include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <chrono>
+#include <mutex>
 #include <thread>
 #include <unordered_set>
 #include <unordered_map>
 
 #include <libusb.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include "completionqueue.h"
+#include "deviceimpl.h"
+#include "latencyrecorder.h"
+
+namespace {
+
+/**
+ * Lookup indexes over the devices known to a context.
+ *
+ * The index stores only raw libusb devices, the Device instances are kept
+ * by the context.
+ */
+class DeviceIndex {
+public:
+	DeviceIndex();
+
+	/**
+	 * Add a device to the index.
+	 */
+	void insert(libusb_device* device);
+	/**
+	 * Remove a device from the index.
+	 */
+	void erase(libusb_device* device);
+	/**
+	 * Check whether the device is indexed.
+	 */
+	bool contains(libusb_device* device) const;
+
+	/**
+	 * Check whether the index has been built.
+	 */
+	bool isBuilt() const;
+	/**
+	 * Mark the index as built.
+	 */
+	void setBuilt();
+
+	/**
+	 * Record the serial number read from the device.
+	 */
+	void setSerial(libusb_device* device, const std::string& serial);
+	/**
+	 * Check whether the serial number of a device still needs to be read.
+	 */
+	bool needsSerial(libusb_device* device) const;
+
+	const std::vector<libusb_device*>& findVidPid(uint16_t vendorId, uint16_t productId) const;
+	libusb_device* findSerial(const std::string& serial) const;
+	libusb_device* findSerial(uint16_t vendorId, uint16_t productId, const std::string& serial) const;
+	libusb_device* findPath(const std::string& path) const;
+
+	/**
+	 * Build the key used for the topology index.
+	 */
+	static std::string makePath(uint8_t bus, const uint8_t* ports, std::size_t count);
+
+private:
+	static uint32_t makeVidPid(uint16_t vendorId, uint16_t productId);
+	/**
+	 * Remove the serial number entry of a single device.
+	 */
+	void eraseSerial(const std::string& serial, libusb_device* device);
+
+	struct Keys {
+		uint32_t vidpid;
+		std::string path;
+		// true if the device has a serial number that hasn't been read yet
+		bool serialPending;
+		std::string serial;
+	};
+
+	bool m_built;
+	std::unordered_map<libusb_device*, Keys> m_keys;
+	std::unordered_map<uint32_t, std::vector<libusb_device*>> m_vidpid;
+	std::unordered_map<std::string, libusb_device*> m_path;
+	// serial numbers are unique only within a vendor and product ID
+	std::unordered_multimap<std::string, libusb_device*> m_serial;
+};
+
+DeviceIndex::DeviceIndex() : m_built(false) {
+
+}
+
+void DeviceIndex::insert(libusb_device* device) {
+	if (contains(device)) {
+		return;
+	}
+
+	libusb_device_descriptor desc;
+	libusb_get_device_descriptor(device, &desc);
+	uint8_t ports[7];
+	int count = libusb_get_port_numbers(device, ports, sizeof(ports));
+
+	Keys keys;
+	keys.vidpid = makeVidPid(desc.idVendor, desc.idProduct);
+	keys.path = makePath(libusb_get_bus_number(device), ports, count > 0 ? count : 0);
+	keys.serialPending = desc.iSerialNumber != 0;
+
+	m_vidpid[keys.vidpid].push_back(device);
+	m_path[keys.path] = device;
+	m_keys.insert(std::make_pair(device, std::move(keys)));
+}
+
+void DeviceIndex::erase(libusb_device* device) {
+	std::unordered_map<libusb_device*, Keys>::iterator it(m_keys.find(device));
+	if (it == m_keys.end()) {
+		return;
+	}
+
+	std::vector<libusb_device*>& vidpid(m_vidpid[it->second.vidpid]);
+	vidpid.erase(std::remove(vidpid.begin(), vidpid.end(), device), vidpid.end());
+	if (vidpid.empty()) {
+		m_vidpid.erase(it->second.vidpid);
+	}
+	m_path.erase(it->second.path);
+	eraseSerial(it->second.serial, device);
+	m_keys.erase(it);
+}
+
+bool DeviceIndex::contains(libusb_device* device) const {
+	return m_keys.find(device) != m_keys.end();
+}
+
+bool DeviceIndex::isBuilt() const {
+	return m_built;
+}
+
+void DeviceIndex::setBuilt() {
+	m_built = true;
+}
+
+void DeviceIndex::setSerial(libusb_device* device, const std::string& serial) {
+	std::unordered_map<libusb_device*, Keys>::iterator it(m_keys.find(device));
+	if (it == m_keys.end()) {
+		return;
+	}
+	it->second.serialPending = false;
+	eraseSerial(it->second.serial, device);
+	it->second.serial = serial;
+	if (!serial.empty()) {
+		m_serial.insert(std::make_pair(serial, device));
+	}
+}
+
+bool DeviceIndex::needsSerial(libusb_device* device) const {
+	std::unordered_map<libusb_device*, Keys>::const_iterator it(m_keys.find(device));
+	return it != m_keys.end() && it->second.serialPending;
+}
+
+const std::vector<libusb_device*>& DeviceIndex::findVidPid(uint16_t vendorId, uint16_t productId) const {
+	static const std::vector<libusb_device*> empty;
+	std::unordered_map<uint32_t, std::vector<libusb_device*>>::const_iterator it(m_vidpid.find(makeVidPid(vendorId, productId)));
+	return it != m_vidpid.end() ? it->second : empty;
+}
+
+libusb_device* DeviceIndex::findSerial(const std::string& serial) const {
+	std::unordered_multimap<std::string, libusb_device*>::const_iterator it(m_serial.find(serial));
+	return it != m_serial.end() ? it->second : nullptr;
+}
+
+libusb_device* DeviceIndex::findSerial(uint16_t vendorId, uint16_t productId, const std::string& serial) const {
+	uint32_t vidpid(makeVidPid(vendorId, productId));
+	auto range(m_serial.equal_range(serial));
+	for (std::unordered_multimap<std::string, libusb_device*>::const_iterator it(range.first); it != range.second; ++it) {
+		if (m_keys.at(it->second).vidpid == vidpid) {
+			return it->second;
+		}
+	}
+	return nullptr;
+}
+
+libusb_device* DeviceIndex::findPath(const std::string& path) const {
+	std::unordered_map<std::string, libusb_device*>::const_iterator it(m_path.find(path));
+	return it != m_path.end() ? it->second : nullptr;
+}
+
+std::string DeviceIndex::makePath(uint8_t bus, const uint8_t* ports, std::size_t count) {
+	std::string path(1, static_cast<char>(bus));
+	path.append(reinterpret_cast<const char*>(ports), count);
+	return path;
+}
+
+void DeviceIndex::eraseSerial(const std::string& serial, libusb_device* device) {
+	auto range(m_serial.equal_range(serial));
+	for (std::unordered_multimap<std::string, libusb_device*>::iterator it(range.first); it != range.second; ++it) {
+		if (it->second == device) {
+			m_serial.erase(it);
+			return;
+		}
+	}
+}
+
+uint32_t DeviceIndex::makeVidPid(uint16_t vendorId, uint16_t productId) {
+	return (static_cast<uint32_t>(vendorId) << 16) | productId;
+}
+
+/**
+ * A read-mostly value published as immutable snapshots.
+ *
+ * Readers take the current snapshot without locking and keep it alive for
+ * as long as they need. Writers modify a private copy of the current snapshot
+ * and publish it with a compare-and-swap, so no writer ever waits for another
+ * one (or for a reader) holding a lock.
+ */
+template <typename T>
+class CowValue {
+public:
+	CowValue() : m_value(std::make_shared<T>()) {
+
+	}
+
+	/**
+	 * Get the current snapshot.
+	 */
+	std::shared_ptr<const T> load() const {
+		return std::atomic_load(&m_value);
+	}
+
+	/**
+	 * Modify the value by applying \a func to a copy of the current snapshot.
+	 *
+	 * If another writer publishes its snapshot first, \a func is applied again
+	 * to a copy of the new snapshot, so it must not have any effects besides
+	 * modifying the copy.
+	 */
+	template <typename F>
+	void update(F func) {
+		std::shared_ptr<const T> current(std::atomic_load(&m_value));
+		std::shared_ptr<const T> copy;
+		do {
+			std::shared_ptr<T> modified(std::make_shared<T>(*current));
+			func(*modified);
+			copy = std::move(modified);
+		} while (!std::atomic_compare_exchange_weak(&m_value, &current, copy));
+	}
+
+private:
+	std::shared_ptr<const T> m_value;
+};
+
+}
 
 namespace Usbpp {
 
@@ -63,6 +311,18 @@ const char* ContextRegisterCBException::what() const noexcept {
 	return "Cannot register callback!";
 }
 
+ContextEventException::ContextEventException(int error) noexcept : Exception(error) {
+
+}
+
+ContextEventException::~ContextEventException() {
+
+}
+
+const char* ContextEventException::what() const noexcept {
+	return "Cannot handle events!";
+}
+
 class Context::Impl {
 public:
 	Impl();
@@ -70,39 +330,173 @@ public:
 	~Impl();
 	/**
 	 * Event loop implementation
+	 *
+	 * \param index index of the thread in the event thread pool
+	 * \param count number of threads in the event thread pool
 	 */
-	void eventLoop();
+	void eventLoop(std::size_t index, std::size_t count, unsigned int generation);
 	/**
-	 * Enter the event loop checking for callbacks
+	 * Busy-poll event loop implementation
+	 */
+	void busyPollLoop(unsigned int generation);
+	/**
+	 * Start the event loop thread, m_eventLoopMutex must be held
 	 */
 	void startEventLoop();
 	/**
-	 * Exit the event loop checking for callbacks
+	 * Tell the event loop threads to exit, m_eventLoopMutex must be held
+	 *
+	 * The threads are only moved to the retired ones, they are joined later
+	 * by joinRetiredThreads() called without holding the lock, so that
+	 * a callback running in an event thread can take the lock in the meantime.
 	 */
 	void stopEventLoop();
+	/**
+	 * Join the stopped event loop threads, m_eventLoopMutex must not be held
+	 *
+	 * The calling thread is never joined, if it is a stopped event loop thread
+	 * itself, it is joined by a later call from another thread.
+	 */
+	void joinRetiredThreads();
+	/**
+	 * Pin the event loop thread to the configured CPU
+	 */
+	void applyEventLoopAffinity();
+	/**
+	 * Set the SCHED_FIFO priority of the busy-poll thread
+	 */
+	void applyBusyPollPriority();
+	/**
+	 * Start the event loop unless the events are handled by the application
+	 */
+	void startEventLoopIfInternal();
+	/**
+	 * Register the hotplug callback and start the event loop
+	 */
+	void enableHotplug();
+	/**
+	 * Deregister the hotplug callback if there are no callbacks left and stop
+	 * the event loop unless it has been started explicitly
+	 */
+	void disableHotplugIfUnused();
 	/**
 	 * Handle a single callback event
 	 */
 	void handleEvent(libusb_device* device, libusb_hotplug_event event);
+	/**
+	 * Deliver an event or add it to the pending batch when coalescing
+	 */
+	void queueEvent(libusb_hotplug_event event, const Device& device);
+	/**
+	 * Deliver the pending batch if the coalescing window has passed
+	 *
+	 * \param force deliver the pending events regardless of the window
+	 * \return time until the pending batch is due or zero if there is none
+	 */
+	std::chrono::milliseconds flushEvents(bool force);
+	/**
+	 * Execute the callbacks for the events
+	 */
+	void dispatchEvents(const std::vector<std::pair<libusb_hotplug_event, Device>>& events);
+	/**
+	 * Build the device index if it hasn't been built yet
+	 */
+	void ensureIndex(Context& context);
+	/**
+	 * Read the serial number of an indexed device, opening it if necessary
+	 */
+	void readSerial(libusb_device* device);
 
-	using DeviceMap = std::unordered_map<libusb_device*, Device>;
+	// the devices are shared by the snapshots, so copying the map is cheap
+	using DeviceMap = std::unordered_map<libusb_device*, std::shared_ptr<const Device>>;
 	using CallbackMap = std::unordered_map<int, std::function<void(Device&)>>;
+	using BatchCallbackMap = std::unordered_map<int, std::function<void(const std::vector<Device>&, const std::vector<Device>&)>>;
+	using Clock = std::chrono::steady_clock;
+
+	/**
+	 * Functions notified about the changes of the poll file descriptors
+	 */
+	struct PollFdNotifiers {
+		std::function<void(int, short)> added;
+		std::function<void(int)> removed;
+	};
 
-	static int m_handleGenerator;
+	/**
+	 * Devices known to the context together with their lookup index
+	 */
+	struct DeviceState {
+		DeviceMap devices;
+		DeviceIndex index;
+	};
+
+	static std::atomic<int> m_handleGenerator;
 	int* m_refcount;
 	libusb_context* m_ctx;
+	// event loop threads
+	std::atomic<bool> m_eventLoopRunning;
+	std::atomic<int> m_eventLoopCpu;
+	unsigned int m_eventLoopThreadCount;
+	std::vector<std::thread> m_eventLoopThreads;
+	// the threads of a loop exit once the generation changes
+	std::atomic<unsigned int> m_eventLoopGeneration;
+	// stopped threads that haven't been joined yet
+	std::vector<std::thread> m_retiredThreads;
+	// transfer callbacks waiting to be run by the event thread pool
+	CompletionQueue m_completions;
+	// busy-poll mode
+	bool m_busyPoll;
+	int m_busyPollCpu;
+	int m_busyPollPriority;
+	std::atomic<bool> m_busyPollRealtime;
+	LatencyRecorder m_latency;
+	// events are handled by the application
+	bool m_externalEvents;
+	CowValue<PollFdNotifiers> m_pollFdNotifiers;
+	// serializes starting and stopping of the event loop and the hotplug callback
+	std::mutex m_eventLoopMutex;
+	// the event loop has been started explicitly by the user
+	bool m_eventLoopRequested;
 	// hotplug callback handling
 	bool m_hotplugEnabled;
-	std::thread m_hotplugThread;
 	libusb_hotplug_callback_handle m_hotplugHandle;
-	DeviceMap m_devices;
-	CallbackMap m_funcConnected;
-	CallbackMap m_funcDisconnected;
+	// the event loop reads the snapshots, it never waits for the writers
+	CowValue<DeviceState> m_state;
+	CowValue<CallbackMap> m_funcConnected;
+	CowValue<CallbackMap> m_funcDisconnected;
+	CowValue<BatchCallbackMap> m_funcChanged;
+	// hotplug event coalescing
+	std::atomic<unsigned int> m_coalescingWindow;
+	std::mutex m_pendingMutex;
+	std::vector<std::pair<libusb_hotplug_event, Device>> m_pendingEvents;
+	Clock::time_point m_pendingFirst;
+	Clock::time_point m_pendingLast;
 };
 
 }
 
 namespace {
+/**
+ * Free function called by libusb when a poll file descriptor is added
+ */
+void LIBUSB_CALL pollFdAdded(int fd, short events, void* user_data) {
+	Usbpp::Context::Impl* contextimpl = static_cast<Usbpp::Context::Impl*>(user_data);
+	std::shared_ptr<const Usbpp::Context::Impl::PollFdNotifiers> notifiers(contextimpl->m_pollFdNotifiers.load());
+	if (notifiers->added) {
+		notifiers->added(fd, events);
+	}
+}
+
+/**
+ * Free function called by libusb when a poll file descriptor is removed
+ */
+void LIBUSB_CALL pollFdRemoved(int fd, void* user_data) {
+	Usbpp::Context::Impl* contextimpl = static_cast<Usbpp::Context::Impl*>(user_data);
+	std::shared_ptr<const Usbpp::Context::Impl::PollFdNotifiers> notifiers(contextimpl->m_pollFdNotifiers.load());
+	if (notifiers->removed) {
+		notifiers->removed(fd);
+	}
+}
+
 /**
  * Free function serving as libusb even handler
  */
@@ -115,9 +509,22 @@ int eventHandler(libusb_context*, libusb_device* device, libusb_hotplug_event ev
 
 namespace Usbpp {
 
-int Context::Impl::m_handleGenerator = 0;
+std::atomic<int> Context::Impl::m_handleGenerator(0);
+
+Context::Impl::Impl() :
+	m_eventLoopRunning(false),
+	m_eventLoopCpu(-1),
+	m_eventLoopThreadCount(1),
+	m_eventLoopGeneration(0),
+	m_busyPoll(false),
+	m_busyPollCpu(-1),
+	m_busyPollPriority(0),
+	m_busyPollRealtime(false),
+	m_externalEvents(false),
+	m_eventLoopRequested(false),
+	m_hotplugEnabled(false),
+	m_coalescingWindow(0) {
 
-Context::Impl::Impl() {
 	m_refcount = new int;
 	*m_refcount = 1;
 	int res = libusb_init(&m_ctx);
@@ -125,15 +532,43 @@ Context::Impl::Impl() {
 		delete m_refcount;
 		throw ContextInitException(res);
 	}
-
-	m_hotplugEnabled = false;
 }
 
-Context::Impl::Impl(const Usbpp::Context::Impl& other): m_refcount(other.m_refcount), m_ctx(other.m_ctx) {
+Context::Impl::Impl(const Usbpp::Context::Impl& other):
+	m_refcount(other.m_refcount),
+	m_ctx(other.m_ctx),
+	m_eventLoopRunning(false),
+	m_eventLoopCpu(-1),
+	m_eventLoopThreadCount(1),
+	m_eventLoopGeneration(0),
+	m_busyPoll(false),
+	m_busyPollCpu(-1),
+	m_busyPollPriority(0),
+	m_busyPollRealtime(false),
+	m_externalEvents(false),
+	m_eventLoopRequested(false),
+	m_hotplugEnabled(false),
+	m_coalescingWindow(other.m_coalescingWindow.load()) {
+
 	++(*m_refcount);
 }
 
 Context::Impl::~Impl() {
+	{
+		std::lock_guard<std::mutex> lock(m_eventLoopMutex);
+		stopEventLoop();
+	}
+	joinRetiredThreads();
+	// only the calling thread may be left if the context is destroyed by its own callback
+	for (std::thread& thread : m_retiredThreads) {
+		thread.detach();
+	}
+	if (m_pollFdNotifiers.load()->added || m_pollFdNotifiers.load()->removed) {
+		libusb_set_pollfd_notifiers(m_ctx, nullptr, nullptr, nullptr);
+	}
+	if (m_hotplugEnabled) {
+		libusb_hotplug_deregister_callback(m_ctx, m_hotplugHandle);
+	}
 	if (m_refcount) {
 		--(*m_refcount);
 		if (*m_refcount == 0) {
@@ -145,68 +580,231 @@ Context::Impl::~Impl() {
 	}
 }
 
-void Context::Impl::eventLoop() {
-	while (m_hotplugEnabled) {
-		libusb_handle_events_completed(NULL, NULL);
-		std::this_thread::sleep_for(std::chrono::seconds(2));
+void Context::Impl::eventLoop(std::size_t index, std::size_t count, unsigned int generation) {
+	// wake up regularly to check whether the loop should exit
+	const std::chrono::milliseconds maxWait(100);
+	std::chrono::milliseconds wait(maxWait);
+	// with a single thread, the callbacks are run directly by the event handler
+	CompletionQueue* queue(count > 1 ? &m_completions : nullptr);
+	while (m_eventLoopGeneration == generation) {
+		timeval tv;
+		tv.tv_sec = 0;
+		tv.tv_usec = std::chrono::duration_cast<std::chrono::microseconds>(wait).count();
+
+		// run the callbacks queued by the event handler
+		while (m_completions.runOne()) {
+		}
+
+		if (libusb_try_lock_events(m_ctx) == 0) {
+			// this thread is the event handler
+			if (libusb_event_handling_ok(m_ctx)) {
+				CompletionQueue::setCurrent(queue);
+				libusb_handle_events_locked(m_ctx, &tv);
+				CompletionQueue::setCurrent(nullptr);
+			}
+			libusb_unlock_events(m_ctx);
+		}
+		else {
+			// another thread handles the events, wait until it finishes
+			libusb_lock_event_waiters(m_ctx);
+			if (libusb_event_handler_active(m_ctx) && !m_completions.hasPending()) {
+				libusb_wait_for_event(m_ctx, &tv);
+			}
+			libusb_unlock_event_waiters(m_ctx);
+		}
+
+		if (index == 0) {
+			wait = flushEvents(false);
+			if (wait == std::chrono::milliseconds::zero() || wait > maxWait) {
+				wait = maxWait;
+			}
+		}
+	}
+	if (index == 0) {
+		flushEvents(true);
+	}
+}
+
+void Context::Impl::busyPollLoop(unsigned int generation) {
+	timeval zero;
+	zero.tv_sec = 0;
+	zero.tv_usec = 0;
+	LatencyRecorder::setCurrent(&m_latency);
+	while (m_eventLoopGeneration == generation) {
+		m_latency.beginPoll();
+		libusb_handle_events_timeout_completed(m_ctx, &zero, nullptr);
+		flushEvents(false);
 	}
+	LatencyRecorder::setCurrent(nullptr);
+	flushEvents(true);
 }
 
 void Context::Impl::startEventLoop() {
-	if (m_hotplugEnabled) {
+	if (m_eventLoopRunning) {
 		return;
 	}
 
-	m_hotplugEnabled = true;
-	int res = libusb_hotplug_register_callback(m_ctx,
-	                                           static_cast<libusb_hotplug_event>(LIBUSB_HOTPLUG_EVENT_DEVICE_ARRIVED | LIBUSB_HOTPLUG_EVENT_DEVICE_LEFT),
-	                                           LIBUSB_HOTPLUG_NO_FLAGS,
-	                                           LIBUSB_HOTPLUG_MATCH_ANY, LIBUSB_HOTPLUG_MATCH_ANY,
-	                                           LIBUSB_HOTPLUG_MATCH_ANY, eventHandler, this,
-	                                           &m_hotplugHandle);
-	if (res != LIBUSB_SUCCESS) {
-		m_hotplugEnabled = false;
-		throw ContextRegisterCBException(res);
+	m_eventLoopRunning = true;
+	unsigned int generation(++m_eventLoopGeneration);
+	if (m_busyPoll) {
+		m_latency.reset();
+		m_eventLoopThreads.resize(1);
+		m_eventLoopThreads[0] = std::thread(&Impl::busyPollLoop, this, generation);
+		applyEventLoopAffinity();
+		applyBusyPollPriority();
+		return;
 	}
-
-	m_hotplugThread = std::thread(&Impl::eventLoop, this);
+	m_eventLoopThreads.resize(m_eventLoopThreadCount);
+	for (std::size_t i = 0; i < m_eventLoopThreads.size(); ++i) {
+		m_eventLoopThreads[i] = std::thread(&Impl::eventLoop, this, i, m_eventLoopThreads.size(), generation);
+	}
+	applyEventLoopAffinity();
 }
 
 void Context::Impl::stopEventLoop() {
+	if (!m_eventLoopRunning) {
+		return;
+	}
+
+	m_eventLoopRunning = false;
+	++m_eventLoopGeneration;
+	for (std::thread& thread : m_eventLoopThreads) {
+		m_retiredThreads.push_back(std::move(thread));
+	}
+	m_eventLoopThreads.clear();
+}
+
+void Context::Impl::joinRetiredThreads() {
+	std::vector<std::thread> threads;
+	{
+		std::lock_guard<std::mutex> lock(m_eventLoopMutex);
+		threads.swap(m_retiredThreads);
+	}
+	std::vector<std::thread> self;
+	for (std::thread& thread : threads) {
+		if (thread.get_id() == std::this_thread::get_id()) {
+			self.push_back(std::move(thread));
+		}
+		else {
+			thread.join();
+		}
+	}
+
+	bool running;
+	{
+		std::lock_guard<std::mutex> lock(m_eventLoopMutex);
+		for (std::thread& thread : self) {
+			m_retiredThreads.push_back(std::move(thread));
+		}
+		running = m_eventLoopRunning;
+	}
+	if (!running) {
+		// run the callbacks that were queued but not run
+		while (m_completions.runOne()) {
+		}
+	}
+}
+
+void Context::Impl::applyEventLoopAffinity() {
+	if (!m_eventLoopRunning) {
+		return;
+	}
+
+	int cpu(m_busyPoll ? m_busyPollCpu : m_eventLoopCpu.load());
+	int cpuCount(std::max(std::thread::hardware_concurrency(), 1u));
+	for (std::size_t i = 0; i < m_eventLoopThreads.size(); ++i) {
+		cpu_set_t cpus;
+		CPU_ZERO(&cpus);
+		if (cpu >= 0) {
+			CPU_SET((cpu + i) % cpuCount, &cpus);
+		}
+		else {
+			// no pinning, allow all CPUs
+			for (int j = 0; j < CPU_SETSIZE; ++j) {
+				CPU_SET(j, &cpus);
+			}
+		}
+		pthread_setaffinity_np(m_eventLoopThreads[i].native_handle(), sizeof(cpus), &cpus);
+	}
+}
+
+void Context::Impl::applyBusyPollPriority() {
+	m_busyPollRealtime = false;
+	if (!m_eventLoopRunning || !m_busyPoll || m_busyPollPriority <= 0) {
+		return;
+	}
+
+	sched_param param;
+	param.sched_priority = m_busyPollPriority;
+	m_busyPollRealtime = pthread_setschedparam(m_eventLoopThreads[0].native_handle(), SCHED_FIFO, &param) == 0;
+}
+
+void Context::Impl::enableHotplug() {
 	if (!m_hotplugEnabled) {
+		int res = libusb_hotplug_register_callback(m_ctx,
+		                                           static_cast<libusb_hotplug_event>(LIBUSB_HOTPLUG_EVENT_DEVICE_ARRIVED | LIBUSB_HOTPLUG_EVENT_DEVICE_LEFT),
+		                                           LIBUSB_HOTPLUG_NO_FLAGS,
+		                                           LIBUSB_HOTPLUG_MATCH_ANY, LIBUSB_HOTPLUG_MATCH_ANY,
+		                                           LIBUSB_HOTPLUG_MATCH_ANY, eventHandler, this,
+		                                           &m_hotplugHandle);
+		if (res != LIBUSB_SUCCESS) {
+			throw ContextRegisterCBException(res);
+		}
+		m_hotplugEnabled = true;
+	}
+
+	startEventLoopIfInternal();
+}
+
+void Context::Impl::startEventLoopIfInternal() {
+	if (!m_externalEvents) {
+		startEventLoop();
+	}
+}
+
+void Context::Impl::disableHotplugIfUnused() {
+	if (!m_funcConnected.load()->empty() || !m_funcDisconnected.load()->empty() || !m_funcChanged.load()->empty()) {
 		return;
 	}
 
-	m_hotplugEnabled = false;
-	m_hotplugThread.join();
-	libusb_hotplug_deregister_callback(m_ctx, m_hotplugHandle);
+	if (!m_eventLoopRequested) {
+		stopEventLoop();
+	}
+	if (m_hotplugEnabled) {
+		libusb_hotplug_deregister_callback(m_ctx, m_hotplugHandle);
+		m_hotplugEnabled = false;
+	}
 }
 
 void Context::Impl::handleEvent(libusb_device* usbdevice, libusb_hotplug_event event) {
 	switch (event) {
 		case LIBUSB_HOTPLUG_EVENT_DEVICE_ARRIVED: {
 			// insert device to the internal map
-			if (m_devices.find(usbdevice) != m_devices.end()) {
-				m_devices.insert(std::make_pair(usbdevice, Device(usbdevice)));
-			}
-			// find device
-			Device& device = m_devices.at(usbdevice);
-			// execute the callbacks
-			for (auto& func : m_funcConnected) {
-				func.second(device);
-			}
+			Device device;
+			m_state.update([&](DeviceState& state) {
+				DeviceMap::iterator it(state.devices.find(usbdevice));
+				if (it == state.devices.end()) {
+					// the device passed to the callback is not referenced on our behalf
+					it = state.devices.insert(std::make_pair(usbdevice, std::make_shared<const Device>(Device(libusb_ref_device(usbdevice), m_ctx)))).first;
+				}
+				state.index.insert(usbdevice);
+				device = *it->second;
+			});
+			queueEvent(event, device);
 			break;
 		}
 		case LIBUSB_HOTPLUG_EVENT_DEVICE_LEFT: {
 			// get device for which to generate callback
-			DeviceMap::iterator it(m_devices.find(usbdevice));
-			Device device = (it != m_devices.end() ? it->second : Device(usbdevice));
-			// execute the callbacks
-			for (auto& func : m_funcDisconnected) {
-				func.second(device);
-			}
+			std::shared_ptr<const DeviceState> snapshot(m_state.load());
+			DeviceMap::const_iterator it(snapshot->devices.find(usbdevice));
+			Device device = (it != snapshot->devices.end() ? *it->second : Device(libusb_ref_device(usbdevice), m_ctx));
+			snapshot.reset();
+			queueEvent(event, device);
 			// erase the device from internal map
-			m_devices.erase(usbdevice);
+			m_state.update([&](DeviceState& state) {
+				state.index.erase(usbdevice);
+				state.devices.erase(usbdevice);
+			});
 			break;
 		}
 		default:
@@ -215,6 +813,109 @@ void Context::Impl::handleEvent(libusb_device* usbdevice, libusb_hotplug_event e
 	}
 }
 
+void Context::Impl::queueEvent(libusb_hotplug_event event, const Device& device) {
+	if (m_coalescingWindow == 0) {
+		dispatchEvents({std::make_pair(event, device)});
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(m_pendingMutex);
+	m_pendingLast = Clock::now();
+	if (m_pendingEvents.empty()) {
+		m_pendingFirst = m_pendingLast;
+	}
+	if (event == LIBUSB_HOTPLUG_EVENT_DEVICE_LEFT) {
+		// a device that arrived within the window cancels out
+		for (std::size_t i = m_pendingEvents.size(); i-- > 0;) {
+			if (m_pendingEvents[i].second == device) {
+				if (m_pendingEvents[i].first == LIBUSB_HOTPLUG_EVENT_DEVICE_ARRIVED) {
+					m_pendingEvents.erase(m_pendingEvents.begin() + i);
+					return;
+				}
+				break;
+			}
+		}
+	}
+	m_pendingEvents.push_back(std::make_pair(event, device));
+}
+
+std::chrono::milliseconds Context::Impl::flushEvents(bool force) {
+	std::vector<std::pair<libusb_hotplug_event, Device>> events;
+	{
+		std::lock_guard<std::mutex> lock(m_pendingMutex);
+		if (m_pendingEvents.empty()) {
+			return std::chrono::milliseconds::zero();
+		}
+		const std::chrono::milliseconds window(m_coalescingWindow);
+		const Clock::time_point due(std::min(m_pendingLast + window, m_pendingFirst + 10 * window));
+		const Clock::time_point now(Clock::now());
+		if (!force && now < due) {
+			return std::chrono::duration_cast<std::chrono::milliseconds>(due - now) + std::chrono::milliseconds(1);
+		}
+		std::swap(events, m_pendingEvents);
+	}
+	dispatchEvents(events);
+	return std::chrono::milliseconds::zero();
+}
+
+void Context::Impl::dispatchEvents(const std::vector<std::pair<libusb_hotplug_event, Device>>& events) {
+	std::shared_ptr<const CallbackMap> funcConnected(m_funcConnected.load());
+	std::shared_ptr<const CallbackMap> funcDisconnected(m_funcDisconnected.load());
+	std::shared_ptr<const BatchCallbackMap> funcChanged(m_funcChanged.load());
+
+	std::vector<Device> connected;
+	std::vector<Device> disconnected;
+	for (const std::pair<libusb_hotplug_event, Device>& event : events) {
+		Device device(event.second);
+		if (event.first == LIBUSB_HOTPLUG_EVENT_DEVICE_ARRIVED) {
+			for (auto& func : *funcConnected) {
+				func.second(device);
+			}
+			connected.push_back(std::move(device));
+		}
+		else {
+			for (auto& func : *funcDisconnected) {
+				func.second(device);
+			}
+			disconnected.push_back(std::move(device));
+		}
+	}
+
+	if (connected.empty() && disconnected.empty()) {
+		return;
+	}
+	for (auto& func : *funcChanged) {
+		func.second(connected, disconnected);
+	}
+}
+
+void Context::Impl::ensureIndex(Context& context) {
+	if (!m_state.load()->index.isBuilt()) {
+		context.getDevices();
+	}
+}
+
+void Context::Impl::readSerial(libusb_device* usbdevice) {
+	std::shared_ptr<const DeviceState> snapshot(m_state.load());
+	if (!snapshot->index.needsSerial(usbdevice)) {
+		return;
+	}
+
+	std::string serial;
+	try {
+		Device device(*snapshot->devices.at(usbdevice));
+		device.open(false);
+		serial = device.getStringDescriptor(device.getDescriptor().iSerialNumber);
+		device.close();
+	}
+	catch (const Exception&) {
+		// the device is inaccessible, don't try to open it again
+	}
+	m_state.update([&](DeviceState& state) {
+		state.index.setSerial(usbdevice, serial);
+	});
+}
+
 Context::Context() : pimpl(new Impl) {
 
 }
@@ -264,42 +965,308 @@ std::vector<Device> Context::getDevices() {
 	std::vector<Device> devicesRes;
 	devicesRes.reserve(count);
 	for (int i(0); i < count; ++i) {
-		Device device(devices[i]);
-		devicesRes.push_back(device);
-		pimpl->m_devices.insert(std::make_pair(devices[i], device));
+		devicesRes.push_back(Device(devices[i], pimpl->m_ctx));
 	}
 
 	libusb_free_device_list(devices, 0);
 
+	pimpl->m_state.update([&](Impl::DeviceState& state) {
+		std::unordered_set<libusb_device*> attached;
+		for (Device& device : devicesRes) {
+			libusb_device* usbdevice(device.pimpl->m_device);
+			state.devices.insert(std::make_pair(usbdevice, std::make_shared<const Device>(device)));
+			state.index.insert(usbdevice);
+			attached.insert(usbdevice);
+		}
+		// forget the devices that are no longer attached
+		for (Impl::DeviceMap::iterator it(state.devices.begin()); it != state.devices.end();) {
+			if (attached.find(it->first) == attached.end()) {
+				state.index.erase(it->first);
+				it = state.devices.erase(it);
+			}
+			else {
+				++it;
+			}
+		}
+		state.index.setBuilt();
+	});
+
+	return devicesRes;
+}
+
+std::vector<Device> Context::findDevices(uint16_t vendorId, uint16_t productId) {
+	pimpl->ensureIndex(*this);
+
+	std::shared_ptr<const Impl::DeviceState> state(pimpl->m_state.load());
+	std::vector<Device> devicesRes;
+	for (libusb_device* device : state->index.findVidPid(vendorId, productId)) {
+		devicesRes.push_back(*state->devices.at(device));
+	}
 	return devicesRes;
 }
 
+Device Context::findDeviceBySerial(const std::string& serial) {
+	pimpl->ensureIndex(*this);
+
+	std::shared_ptr<const Impl::DeviceState> state(pimpl->m_state.load());
+	libusb_device* found(state->index.findSerial(serial));
+	if (found == nullptr) {
+		// read the serial numbers that are not known yet
+		for (const Impl::DeviceMap::value_type& device : state->devices) {
+			pimpl->readSerial(device.first);
+		}
+		state = pimpl->m_state.load();
+		found = state->index.findSerial(serial);
+	}
+	return found != nullptr ? *state->devices.at(found) : Device();
+}
+
+Device Context::findDeviceBySerial(uint16_t vendorId, uint16_t productId, const std::string& serial) {
+	pimpl->ensureIndex(*this);
+
+	std::shared_ptr<const Impl::DeviceState> state(pimpl->m_state.load());
+	libusb_device* found(state->index.findSerial(vendorId, productId, serial));
+	if (found == nullptr) {
+		// read the serial numbers of the matching devices that are not known yet
+		for (libusb_device* device : state->index.findVidPid(vendorId, productId)) {
+			pimpl->readSerial(device);
+		}
+		state = pimpl->m_state.load();
+		found = state->index.findSerial(vendorId, productId, serial);
+	}
+	return found != nullptr ? *state->devices.at(found) : Device();
+}
+
+Device Context::findDeviceByPath(uint8_t bus, const std::vector<uint8_t>& ports) {
+	pimpl->ensureIndex(*this);
+
+	std::shared_ptr<const Impl::DeviceState> state(pimpl->m_state.load());
+	libusb_device* found(state->index.findPath(DeviceIndex::makePath(bus, ports.data(), ports.size())));
+	return found != nullptr ? *state->devices.at(found) : Device();
+}
+
 int Context::registerDeviceConnected(const std::function<void(Device&)>& func) {
 	int handle = pimpl->m_handleGenerator++;
-	pimpl->m_funcConnected.insert(std::make_pair(handle, func));
-	pimpl->startEventLoop();
+	pimpl->m_funcConnected.update([&](Impl::CallbackMap& callbacks) {
+		callbacks.insert(std::make_pair(handle, func));
+	});
+	std::lock_guard<std::mutex> lock(pimpl->m_eventLoopMutex);
+	pimpl->enableHotplug();
 	return handle;
 }
 
 int Context::registerDeviceDisconnected(const std::function<void(Device&)>& func) {
 	int handle = pimpl->m_handleGenerator++;
-	pimpl->m_funcDisconnected.insert(std::make_pair(handle, func));
-	pimpl->startEventLoop();
+	pimpl->m_funcDisconnected.update([&](Impl::CallbackMap& callbacks) {
+		callbacks.insert(std::make_pair(handle, func));
+	});
+	std::lock_guard<std::mutex> lock(pimpl->m_eventLoopMutex);
+	pimpl->enableHotplug();
 	return handle;
 }
 
 void Context::unregisterDeviceConnected(int handle) {
-	pimpl->m_funcConnected.erase(handle);
-	if (pimpl->m_funcConnected.empty() && pimpl->m_funcDisconnected.empty()) {
-		pimpl->stopEventLoop();
+	pimpl->m_funcConnected.update([&](Impl::CallbackMap& callbacks) {
+		callbacks.erase(handle);
+	});
+	{
+		std::lock_guard<std::mutex> lock(pimpl->m_eventLoopMutex);
+		pimpl->disableHotplugIfUnused();
 	}
+	pimpl->joinRetiredThreads();
 }
 
 void Context::unregisterDeviceDisconnected(int handle) {
-	pimpl->m_funcDisconnected.erase(handle);
-	if (pimpl->m_funcConnected.empty() && pimpl->m_funcDisconnected.empty()) {
-		pimpl->stopEventLoop();
+	pimpl->m_funcDisconnected.update([&](Impl::CallbackMap& callbacks) {
+		callbacks.erase(handle);
+	});
+	{
+		std::lock_guard<std::mutex> lock(pimpl->m_eventLoopMutex);
+		pimpl->disableHotplugIfUnused();
+	}
+	pimpl->joinRetiredThreads();
+}
+
+int Context::registerDevicesChanged(const std::function<void(const std::vector<Device>&, const std::vector<Device>&)>& func) {
+	int handle = pimpl->m_handleGenerator++;
+	pimpl->m_funcChanged.update([&](Impl::BatchCallbackMap& callbacks) {
+		callbacks.insert(std::make_pair(handle, func));
+	});
+	std::lock_guard<std::mutex> lock(pimpl->m_eventLoopMutex);
+	pimpl->enableHotplug();
+	return handle;
+}
+
+void Context::unregisterDevicesChanged(int handle) {
+	pimpl->m_funcChanged.update([&](Impl::BatchCallbackMap& callbacks) {
+		callbacks.erase(handle);
+	});
+	{
+		std::lock_guard<std::mutex> lock(pimpl->m_eventLoopMutex);
+		pimpl->disableHotplugIfUnused();
+	}
+	pimpl->joinRetiredThreads();
+}
+
+void Context::setHotplugCoalescing(unsigned int window) {
+	pimpl->m_coalescingWindow = window;
+}
+
+void Context::startEventLoop() {
+	std::lock_guard<std::mutex> lock(pimpl->m_eventLoopMutex);
+	pimpl->m_eventLoopRequested = true;
+	pimpl->startEventLoop();
+}
+
+void Context::stopEventLoop() {
+	{
+		std::lock_guard<std::mutex> lock(pimpl->m_eventLoopMutex);
+		pimpl->m_eventLoopRequested = false;
+		if (!pimpl->m_hotplugEnabled) {
+			pimpl->stopEventLoop();
+		}
+	}
+	pimpl->joinRetiredThreads();
+}
+
+void Context::setEventThreadCount(unsigned int count) {
+	{
+		std::lock_guard<std::mutex> lock(pimpl->m_eventLoopMutex);
+		pimpl->m_eventLoopThreadCount = std::max(count, 1u);
+		// restart the running event loop with the new number of threads
+		if (pimpl->m_eventLoopRunning && pimpl->m_eventLoopThreads.size() != pimpl->m_eventLoopThreadCount) {
+			pimpl->stopEventLoop();
+			pimpl->startEventLoop();
+		}
+	}
+	pimpl->joinRetiredThreads();
+}
+
+void Context::setEventLoopAffinity(int cpu) {
+	std::lock_guard<std::mutex> lock(pimpl->m_eventLoopMutex);
+	pimpl->m_eventLoopCpu = cpu;
+	pimpl->applyEventLoopAffinity();
+}
+
+void Context::setBusyPoll(bool enable, int cpu, int priority) {
+	{
+		std::lock_guard<std::mutex> lock(pimpl->m_eventLoopMutex);
+		bool running(pimpl->m_eventLoopRunning);
+		if (running) {
+			pimpl->stopEventLoop();
+		}
+		pimpl->m_busyPoll = enable;
+		pimpl->m_busyPollCpu = cpu;
+		pimpl->m_busyPollPriority = priority;
+		if (running) {
+			pimpl->startEventLoop();
+		}
+	}
+	pimpl->joinRetiredThreads();
+}
+
+BusyPollStatistics Context::getBusyPollStatistics() const {
+	BusyPollStatistics stats;
+	stats.polls = pimpl->m_latency.getPolls();
+	stats.completions = pimpl->m_latency.getCompletions();
+	stats.minLatency = pimpl->m_latency.getMin();
+	stats.meanLatency = pimpl->m_latency.getMean();
+	stats.maxLatency = pimpl->m_latency.getMax();
+	stats.realtime = pimpl->m_busyPollRealtime;
+	return stats;
+}
+
+void Context::setExternalEventHandling(bool enable) {
+	{
+		std::lock_guard<std::mutex> lock(pimpl->m_eventLoopMutex);
+		pimpl->m_externalEvents = enable;
+		if (pimpl->m_hotplugEnabled && !pimpl->m_eventLoopRequested) {
+			if (enable) {
+				pimpl->stopEventLoop();
+			}
+			else {
+				pimpl->startEventLoop();
+			}
+		}
+	}
+	pimpl->joinRetiredThreads();
+}
+
+std::vector<PollFd> Context::getPollFds() const {
+	std::vector<PollFd> result;
+	const libusb_pollfd** pollfds(libusb_get_pollfds(pimpl->m_ctx));
+	if (pollfds == nullptr) {
+		return result;
+	}
+	for (const libusb_pollfd** it = pollfds; *it != nullptr; ++it) {
+		PollFd pollfd;
+		pollfd.fd = (*it)->fd;
+		pollfd.events = (*it)->events;
+		result.push_back(pollfd);
+	}
+	libusb_free_pollfds(pollfds);
+	return result;
+}
+
+void Context::setPollFdNotifiers(const std::function<void(int, short)>& added, const std::function<void(int)>& removed) {
+	pimpl->m_pollFdNotifiers.update([&](Impl::PollFdNotifiers& notifiers) {
+		notifiers.added = added;
+		notifiers.removed = removed;
+	});
+	libusb_set_pollfd_notifiers(pimpl->m_ctx, pollFdAdded, pollFdRemoved, pimpl.get());
+}
+
+void Context::clearPollFdNotifiers() {
+	libusb_set_pollfd_notifiers(pimpl->m_ctx, nullptr, nullptr, nullptr);
+	pimpl->m_pollFdNotifiers.update([](Impl::PollFdNotifiers& notifiers) {
+		notifiers.added = nullptr;
+		notifiers.removed = nullptr;
+	});
+}
+
+bool Context::pollFdsHandleTimeouts() const {
+	// the coalescing window is not backed by any file descriptor
+	if (pimpl->m_coalescingWindow != 0) {
+		return false;
+	}
+	return libusb_pollfds_handle_timeouts(pimpl->m_ctx) != 0;
+}
+
+bool Context::getNextTimeout(std::chrono::microseconds& timeout) const {
+	timeval tv;
+	int res = libusb_get_next_timeout(pimpl->m_ctx, &tv);
+	if (res < 0) {
+		throw ContextEventException(res);
+	}
+	bool pending(res == 1);
+	if (pending) {
+		timeout = std::chrono::seconds(tv.tv_sec) + std::chrono::microseconds(tv.tv_usec);
+	}
+
+	// the pending hotplug events have to be delivered when the coalescing window passes
+	std::lock_guard<std::mutex> lock(pimpl->m_pendingMutex);
+	if (!pimpl->m_pendingEvents.empty()) {
+		const std::chrono::milliseconds window(pimpl->m_coalescingWindow);
+		const Impl::Clock::time_point due(std::min(pimpl->m_pendingLast + window, pimpl->m_pendingFirst + 10 * window));
+		const std::chrono::microseconds remaining(std::max(std::chrono::duration_cast<std::chrono::microseconds>(due - Impl::Clock::now()),
+		                                                   std::chrono::microseconds::zero()));
+		if (!pending || remaining < timeout) {
+			timeout = remaining;
+		}
+		pending = true;
+	}
+	return pending;
+}
+
+void Context::handleEventsNonBlocking() {
+	timeval zero;
+	zero.tv_sec = 0;
+	zero.tv_usec = 0;
+	int res = libusb_handle_events_timeout_completed(pimpl->m_ctx, &zero, nullptr);
+	if (res < 0) {
+		throw ContextEventException(res);
 	}
+	pimpl->flushEvents(false);
 }
 
 }
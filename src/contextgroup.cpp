@@ -0,0 +1,248 @@
+/*
+ * This file is part of Usbpp, a C++ wrapper around libusb
+ * Copyright (C) 2016  Lukas Jirkovsky <l.jirkovsky @at@ gmail.com>
+ *
+ * Usbpp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, version 3 of the License
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "contextgroup.h"
+
+#include <algorithm>
+#include <cassert>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+namespace {
+
+std::size_t busPolicy(uint8_t bus, const std::vector<uint8_t>&) {
+	return bus;
+}
+
+}
+
+namespace Usbpp {
+
+class ContextGroup::Impl {
+public:
+	Impl(std::size_t shards, const Policy& policy_);
+
+	std::size_t getShard(const Device& device) const;
+	/**
+	 * Keep only the devices owned by the shard.
+	 */
+	std::vector<Device> filter(std::size_t shard, const std::vector<Device>& devices) const;
+
+	// declared before the shards, the callbacks running in the shards use it
+	Policy m_policy;
+	std::vector<std::unique_ptr<Context>> m_shards;
+
+	// registered callbacks: group handle -> handle in each shard
+	std::mutex m_handlesMutex;
+	int m_handleGenerator;
+	std::unordered_map<int, std::vector<int>> m_handles;
+};
+
+ContextGroup::Impl::Impl(std::size_t shards, const Policy& policy_) :
+	m_policy(policy_),
+	m_handleGenerator(0) {
+
+	assert(shards > 0);
+	m_shards.reserve(shards);
+	for (std::size_t i = 0; i < shards; ++i) {
+		m_shards.emplace_back(new Context);
+	}
+}
+
+std::size_t ContextGroup::Impl::getShard(const Device& device) const {
+	return m_policy(device.getBusNumber(), device.getPortNumbers()) % m_shards.size();
+}
+
+std::vector<Device> ContextGroup::Impl::filter(std::size_t shard, const std::vector<Device>& devices) const {
+	std::vector<Device> owned;
+	for (const Device& device : devices) {
+		if (getShard(device) == shard) {
+			owned.push_back(device);
+		}
+	}
+	return owned;
+}
+
+ContextGroup::ContextGroup(std::size_t shards) : ContextGroup(shards, busPolicy) {
+
+}
+
+ContextGroup::ContextGroup(std::size_t shards, const Policy& policy) : pimpl(new Impl(shards, policy)) {
+	unsigned int cpus(std::max(std::thread::hardware_concurrency(), 1u));
+	for (std::size_t i = 0; i < pimpl->m_shards.size(); ++i) {
+		pimpl->m_shards[i]->setEventLoopAffinity(i % cpus);
+		pimpl->m_shards[i]->startEventLoop();
+	}
+}
+
+ContextGroup::~ContextGroup() {
+	for (std::unique_ptr<Context>& shard : pimpl->m_shards) {
+		shard->stopEventLoop();
+	}
+	// the event loops keep running while any callback is registered, destroying
+	// the shards joins them before the callbacks lose the state they refer to
+	pimpl->m_shards.clear();
+}
+
+std::size_t ContextGroup::size() const {
+	return pimpl->m_shards.size();
+}
+
+Context& ContextGroup::getContext(std::size_t shard) {
+	return *pimpl->m_shards.at(shard);
+}
+
+std::size_t ContextGroup::getShard(const Device& device) const {
+	return pimpl->getShard(device);
+}
+
+void ContextGroup::setEventLoopAffinity(const std::vector<int>& cpus) {
+	for (std::size_t i = 0; i < cpus.size() && i < pimpl->m_shards.size(); ++i) {
+		pimpl->m_shards[i]->setEventLoopAffinity(cpus[i]);
+	}
+}
+
+std::vector<Device> ContextGroup::getDevices() {
+	std::vector<Device> devices;
+	for (std::size_t i = 0; i < pimpl->m_shards.size(); ++i) {
+		std::vector<Device> owned(pimpl->filter(i, pimpl->m_shards[i]->getDevices()));
+		devices.insert(devices.end(), owned.begin(), owned.end());
+	}
+	return devices;
+}
+
+std::vector<Device> ContextGroup::findDevices(uint16_t vendorId, uint16_t productId) {
+	std::vector<Device> devices;
+	for (std::size_t i = 0; i < pimpl->m_shards.size(); ++i) {
+		std::vector<Device> owned(pimpl->filter(i, pimpl->m_shards[i]->findDevices(vendorId, productId)));
+		devices.insert(devices.end(), owned.begin(), owned.end());
+	}
+	return devices;
+}
+
+Device ContextGroup::findDeviceBySerial(const std::string& serial) {
+	// the serial numbers are read only by the first shard to open every device at most once
+	Device device(pimpl->m_shards[0]->findDeviceBySerial(serial));
+	if (!device.isValid()) {
+		return device;
+	}
+	return findDeviceByPath(device.getBusNumber(), device.getPortNumbers());
+}
+
+Device ContextGroup::findDeviceByPath(uint8_t bus, const std::vector<uint8_t>& ports) {
+	std::size_t shard(pimpl->m_policy(bus, ports) % pimpl->m_shards.size());
+	return pimpl->m_shards[shard]->findDeviceByPath(bus, ports);
+}
+
+int ContextGroup::registerDeviceConnected(const std::function<void(Device&)>& func) {
+	std::vector<int> handles;
+	for (std::size_t i = 0; i < pimpl->m_shards.size(); ++i) {
+		Impl* impl(pimpl.get());
+		handles.push_back(pimpl->m_shards[i]->registerDeviceConnected([impl, i, func](Device& device) {
+			if (impl->getShard(device) == i) {
+				func(device);
+			}
+		}));
+	}
+
+	std::lock_guard<std::mutex> lock(pimpl->m_handlesMutex);
+	int handle(pimpl->m_handleGenerator++);
+	pimpl->m_handles.insert(std::make_pair(handle, std::move(handles)));
+	return handle;
+}
+
+int ContextGroup::registerDeviceDisconnected(const std::function<void(Device&)>& func) {
+	std::vector<int> handles;
+	for (std::size_t i = 0; i < pimpl->m_shards.size(); ++i) {
+		Impl* impl(pimpl.get());
+		handles.push_back(pimpl->m_shards[i]->registerDeviceDisconnected([impl, i, func](Device& device) {
+			if (impl->getShard(device) == i) {
+				func(device);
+			}
+		}));
+	}
+
+	std::lock_guard<std::mutex> lock(pimpl->m_handlesMutex);
+	int handle(pimpl->m_handleGenerator++);
+	pimpl->m_handles.insert(std::make_pair(handle, std::move(handles)));
+	return handle;
+}
+
+int ContextGroup::registerDevicesChanged(const std::function<void(const std::vector<Device>&, const std::vector<Device>&)>& func) {
+	std::vector<int> handles;
+	for (std::size_t i = 0; i < pimpl->m_shards.size(); ++i) {
+		Impl* impl(pimpl.get());
+		handles.push_back(pimpl->m_shards[i]->registerDevicesChanged([impl, i, func](const std::vector<Device>& connected,
+		                                                                                const std::vector<Device>& disconnected) {
+			std::vector<Device> ownedConnected(impl->filter(i, connected));
+			std::vector<Device> ownedDisconnected(impl->filter(i, disconnected));
+			if (!ownedConnected.empty() || !ownedDisconnected.empty()) {
+				func(ownedConnected, ownedDisconnected);
+			}
+		}));
+	}
+
+	std::lock_guard<std::mutex> lock(pimpl->m_handlesMutex);
+	int handle(pimpl->m_handleGenerator++);
+	pimpl->m_handles.insert(std::make_pair(handle, std::move(handles)));
+	return handle;
+}
+
+void ContextGroup::unregisterDeviceConnected(int handle) {
+	std::lock_guard<std::mutex> lock(pimpl->m_handlesMutex);
+	std::unordered_map<int, std::vector<int>>::iterator it(pimpl->m_handles.find(handle));
+	if (it == pimpl->m_handles.end()) {
+		return;
+	}
+	for (std::size_t i = 0; i < it->second.size(); ++i) {
+		pimpl->m_shards[i]->unregisterDeviceConnected(it->second[i]);
+	}
+	pimpl->m_handles.erase(it);
+}
+
+void ContextGroup::unregisterDeviceDisconnected(int handle) {
+	std::lock_guard<std::mutex> lock(pimpl->m_handlesMutex);
+	std::unordered_map<int, std::vector<int>>::iterator it(pimpl->m_handles.find(handle));
+	if (it == pimpl->m_handles.end()) {
+		return;
+	}
+	for (std::size_t i = 0; i < it->second.size(); ++i) {
+		pimpl->m_shards[i]->unregisterDeviceDisconnected(it->second[i]);
+	}
+	pimpl->m_handles.erase(it);
+}
+
+void ContextGroup::unregisterDevicesChanged(int handle) {
+	std::lock_guard<std::mutex> lock(pimpl->m_handlesMutex);
+	std::unordered_map<int, std::vector<int>>::iterator it(pimpl->m_handles.find(handle));
+	if (it == pimpl->m_handles.end()) {
+		return;
+	}
+	for (std::size_t i = 0; i < it->second.size(); ++i) {
+		pimpl->m_shards[i]->unregisterDevicesChanged(it->second[i]);
+	}
+	pimpl->m_handles.erase(it);
+}
+
+void ContextGroup::setHotplugCoalescing(unsigned int window) {
+	for (std::unique_ptr<Context>& shard : pimpl->m_shards) {
+		shard->setHotplugCoalescing(window);
+	}
+}
+
+}
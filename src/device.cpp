@@ -17,14 +17,60 @@
 
 #include "device.h"
 
+#include <algorithm>
 #include <cassert>
+#include <climits>
 #include <libusb.h>
+#include <memory>
 #include <unistd.h>
 #include <unordered_map>
 #include <unordered_set>
 #include <sstream>
+#include <vector>
 
+#include "bufferchain.h"
+#include "completionqueue.h"
 #include "deviceimpl.h"
+#include "latencyrecorder.h"
+
+namespace {
+
+/**
+ * Free function serving as libusb transfer callback
+ */
+void LIBUSB_CALL transferCallback(libusb_transfer* transfer) {
+	std::unique_ptr<Usbpp::TransferCallback> callback(static_cast<Usbpp::TransferCallback*>(transfer->user_data));
+	int error(Usbpp::getTransferError(transfer->status));
+	int transferred(transfer->actual_length);
+	std::uintptr_t key(Usbpp::CompletionQueue::makeKey(transfer->dev_handle, transfer->endpoint));
+	libusb_free_transfer(transfer);
+
+	// with multiple event threads, run the callback outside of the event handling
+	Usbpp::CompletionQueue* queue(Usbpp::CompletionQueue::current());
+	if (queue != nullptr) {
+		Usbpp::TransferCallback* func(callback.release());
+		queue->push(key, [func, error, transferred]() {
+			std::unique_ptr<Usbpp::TransferCallback> deleter(func);
+			(*func)(error, transferred);
+		});
+	}
+	else {
+		Usbpp::LatencyRecorder* recorder(Usbpp::LatencyRecorder::current());
+		if (recorder != nullptr) {
+			recorder->record();
+		}
+		(*callback)(error, transferred);
+	}
+}
+
+/**
+ * Callback of the chunks of a split bulk transfer, marks the chunk as completed
+ */
+void LIBUSB_CALL chunkCallback(libusb_transfer* transfer) {
+	*static_cast<int*>(transfer->user_data) = 1;
+}
+
+}
 
 namespace Usbpp {
 
@@ -53,27 +99,39 @@ const char* DeviceTransferException::what() const noexcept {
 }
 
 Device::Impl::Impl() :
+	m_context(nullptr),
 	m_device(nullptr),
 	m_handle(nullptr),
 	m_handleRefCount(nullptr),
-	m_interfaceRefCount(nullptr) {
+	m_interfaceRefCount(nullptr),
+	m_chunkSize(0),
+	m_chunkDepth(1),
+	m_chunkIn(false) {
 
 }
 
-Device::Impl::Impl(libusb_device* device_) :
+Device::Impl::Impl(libusb_device* device_, libusb_context* context) :
+	m_context(context),
 	m_device(device_),
 	m_handle(nullptr),
 	m_handleRefCount(nullptr),
-	m_interfaceRefCount(nullptr) {
+	m_interfaceRefCount(nullptr),
+	m_chunkSize(0),
+	m_chunkDepth(1),
+	m_chunkIn(false) {
 
 }
 
 Device::Impl::Impl(const Impl& other) :
+	m_context(other.m_context),
 	m_device(other.m_device),
 	m_handle(other.m_handle),
 	m_handleRefCount(other.m_handleRefCount),
 	m_interfaceMyClaimed(other.m_interfaceMyClaimed),
-	m_interfaceRefCount(other.m_interfaceRefCount) {
+	m_interfaceRefCount(other.m_interfaceRefCount),
+	m_chunkSize(other.m_chunkSize),
+	m_chunkDepth(other.m_chunkDepth),
+	m_chunkIn(other.m_chunkIn) {
 
 	if (m_device) {
 		libusb_ref_device(m_device);
@@ -127,6 +185,177 @@ void Device::Impl::releaseInterface(int bInterfaceNumber) {
 	}
 }
 
+void Device::Impl::submitTransfer(unsigned char type,
+                                  unsigned char endpoint,
+                                  unsigned char* data,
+                                  int length,
+                                  unsigned int timeout,
+                                  const TransferCallback& callback) const {
+	libusb_transfer* transfer(libusb_alloc_transfer(0));
+	if (transfer == nullptr) {
+		throw DeviceTransferException(LIBUSB_ERROR_NO_MEM);
+	}
+	TransferCallback* func(new TransferCallback(callback));
+	if (type == LIBUSB_TRANSFER_TYPE_CONTROL) {
+		// the data begin with the setup packet, which also specifies the length
+		libusb_fill_control_transfer(transfer, m_handle, data, transferCallback, func, timeout);
+	}
+	else if (type == LIBUSB_TRANSFER_TYPE_INTERRUPT) {
+		libusb_fill_interrupt_transfer(transfer, m_handle, endpoint, data, length, transferCallback, func, timeout);
+	}
+	else {
+		libusb_fill_bulk_transfer(transfer, m_handle, endpoint, data, length, transferCallback, func, timeout);
+	}
+
+	int res(libusb_submit_transfer(transfer));
+	if (res != 0) {
+		delete func;
+		libusb_free_transfer(transfer);
+		throw DeviceTransferException(res);
+	}
+}
+
+int getTransferError(libusb_transfer_status status) {
+	switch (status) {
+		case LIBUSB_TRANSFER_COMPLETED:
+			return LIBUSB_SUCCESS;
+		case LIBUSB_TRANSFER_TIMED_OUT:
+			return LIBUSB_ERROR_TIMEOUT;
+		case LIBUSB_TRANSFER_CANCELLED:
+			return LIBUSB_ERROR_INTERRUPTED;
+		case LIBUSB_TRANSFER_STALL:
+			return LIBUSB_ERROR_PIPE;
+		case LIBUSB_TRANSFER_NO_DEVICE:
+			return LIBUSB_ERROR_NO_DEVICE;
+		case LIBUSB_TRANSFER_OVERFLOW:
+			return LIBUSB_ERROR_OVERFLOW;
+		default:
+			return LIBUSB_ERROR_IO;
+	}
+}
+
+int Device::Impl::chunkedBulkTransfer(unsigned char endpoint,
+                                      unsigned char* data,
+                                      std::size_t length,
+                                      unsigned int timeout) const {
+	const bool in((endpoint & LIBUSB_ENDPOINT_IN) != 0);
+	const std::size_t count((length + m_chunkSize - 1) / m_chunkSize);
+	const std::size_t depth(std::min<std::size_t>(std::max(m_chunkDepth, 1u), count));
+
+	std::vector<libusb_transfer*> transfers(depth, nullptr);
+	std::vector<int> completed(depth, 1);
+	for (std::size_t i = 0; i < depth; i++) {
+		transfers[i] = libusb_alloc_transfer(0);
+		if (transfers[i] == nullptr) {
+			for (std::size_t j = 0; j < i; j++) {
+				libusb_free_transfer(transfers[j]);
+			}
+			throw DeviceTransferException(LIBUSB_ERROR_NO_MEM);
+		}
+	}
+
+	// chunk i always uses the slot i % depth
+	auto submit = [&](std::size_t chunk) {
+		std::size_t slot(chunk % depth);
+		std::size_t offset(chunk * m_chunkSize);
+		libusb_fill_bulk_transfer(transfers[slot], m_handle, endpoint, data + offset,
+		                          std::min(m_chunkSize, length - offset), chunkCallback, &completed[slot], timeout);
+		// a short packet in the middle must stop the chunks queued after it
+		transfers[slot]->flags = (in && chunk + 1 < count) ? LIBUSB_TRANSFER_SHORT_NOT_OK : 0;
+		completed[slot] = 0;
+		int res(libusb_submit_transfer(transfers[slot]));
+		if (res != 0) {
+			completed[slot] = 1;
+		}
+		return res;
+	};
+
+	std::size_t submitted(0);
+	std::size_t finished(0);
+	std::size_t transferred(0);
+	int error(0);
+	bool done(false);
+	while (submitted < depth && error == 0) {
+		error = submit(submitted);
+		if (error == 0) {
+			submitted++;
+		}
+	}
+	if (error != 0) {
+		done = true;
+		for (std::size_t i = 0; i < submitted; i++) {
+			libusb_cancel_transfer(transfers[i]);
+		}
+	}
+
+	while (finished < submitted) {
+		std::size_t slot(finished % depth);
+		libusb_transfer* transfer(transfers[slot]);
+		while (! completed[slot]) {
+			int res(libusb_handle_events_completed(m_context, &completed[slot]));
+			if (res < 0 && res != LIBUSB_ERROR_INTERRUPTED) {
+				libusb_cancel_transfer(transfer);
+			}
+		}
+		finished++;
+		if (done) {
+			// the remaining chunks were cancelled, just wait for them
+			continue;
+		}
+
+		bool shortPacket(transfer->actual_length < transfer->length &&
+		                 (transfer->status == LIBUSB_TRANSFER_COMPLETED ||
+		                  (transfer->status == LIBUSB_TRANSFER_ERROR && (transfer->flags & LIBUSB_TRANSFER_SHORT_NOT_OK))));
+		if (transfer->status == LIBUSB_TRANSFER_COMPLETED || shortPacket) {
+			transferred += transfer->actual_length;
+		}
+		else {
+			error = getTransferError(transfer->status);
+		}
+
+		if (! shortPacket && error == 0 && submitted < count) {
+			error = submit(submitted);
+			if (error == 0) {
+				submitted++;
+			}
+		}
+		if (shortPacket || error != 0) {
+			done = true;
+			for (std::size_t i = finished; i < submitted; i++) {
+				libusb_cancel_transfer(transfers[i % depth]);
+			}
+		}
+	}
+
+	for (libusb_transfer* transfer : transfers) {
+		libusb_free_transfer(transfer);
+	}
+	if (error != 0) {
+		throw DeviceTransferException(error);
+	}
+	return static_cast<int>(transferred);
+}
+
+int Device::Impl::bulkTransferOut(unsigned char endpoint,
+                                  const std::uint8_t* data,
+                                  std::size_t length,
+                                  unsigned int timeout) const {
+	unsigned char* buffer(const_cast<unsigned char*>(data));
+	// the number of bytes transferred must fit in the return value
+	if (length > INT_MAX) {
+		throw DeviceTransferException(LIBUSB_ERROR_INVALID_PARAM);
+	}
+	if (m_chunkSize != 0 && length > m_chunkSize) {
+		return chunkedBulkTransfer(endpoint, buffer, length, timeout);
+	}
+	int transferred(0);
+	int res = libusb_bulk_transfer(m_handle, endpoint, buffer, length, &transferred, timeout);
+	if (res != 0) {
+		throw DeviceTransferException(res);
+	}
+	return transferred;
+}
+
 Device::Device() : pimpl(new Impl) {
 
 }
@@ -139,7 +368,7 @@ Device::Device(Device&& other) noexcept : pimpl(std::move(other.pimpl)) {
 
 }
 
-Device::Device(libusb_device* device_) : pimpl(new Impl(device_)) {
+Device::Device(libusb_device* device_, libusb_context* context) : pimpl(new Impl(device_, context)) {
 
 }
 
@@ -212,6 +441,30 @@ libusb_device_descriptor Device::getDescriptor() {
 	return desc;
 }
 
+uint8_t Device::getBusNumber() const {
+	return libusb_get_bus_number(pimpl->m_device);
+}
+
+std::vector<uint8_t> Device::getPortNumbers() const {
+	// USB 3.0 limits the depth of the topology to 7 ports
+	std::vector<uint8_t> ports(7);
+	int count = libusb_get_port_numbers(pimpl->m_device, ports.data(), ports.size());
+	if (count < 0) {
+		throw DeviceTransferException(count);
+	}
+	ports.resize(count);
+	return ports;
+}
+
+std::string Device::getStringDescriptor(uint8_t index) const {
+	unsigned char buffer[256];
+	int res = libusb_get_string_descriptor_ascii(pimpl->m_handle, index, buffer, sizeof(buffer));
+	if (res < 0) {
+		throw DeviceTransferException(res);
+	}
+	return std::string(reinterpret_cast<const char*>(buffer), res);
+}
+
 int Device::getConfiguration() {
 	int config;
 	int res = libusb_get_configuration(pimpl->m_handle, &config);
@@ -261,10 +514,25 @@ int Device::controlTransferIn(uint8_t bmRequestType,
 	return res;
 }
 
+void Device::setBulkChunking(std::size_t chunkSize, unsigned int depth, bool splitIn) {
+	if (chunkSize != 0) {
+		chunkSize = std::max<std::size_t>(chunkSize - chunkSize % 1024, 1024);
+	}
+	pimpl->m_chunkSize = chunkSize;
+	pimpl->m_chunkDepth = std::max(depth, 1u);
+	pimpl->m_chunkIn = splitIn;
+}
+
 int Device::bulkTransferIn(unsigned char endpoint,
                            ByteBuffer& data,
                            unsigned int timeout) const {
 	assert(endpoint & LIBUSB_ENDPOINT_IN);
+	if (data.size() > INT_MAX) {
+		throw DeviceTransferException(LIBUSB_ERROR_INVALID_PARAM);
+	}
+	if (pimpl->m_chunkIn && pimpl->m_chunkSize != 0 && data.size() > pimpl->m_chunkSize) {
+		return pimpl->chunkedBulkTransfer(endpoint, data.data(), data.size(), timeout);
+	}
 	int transferred(0);
 	int res = libusb_bulk_transfer(pimpl->m_handle, endpoint, data.data(), data.size(), &transferred, timeout);
 	if (res != 0) {
@@ -304,11 +572,35 @@ int Device::bulkTransferOut(unsigned char endpoint,
                             const ByteBuffer& data,
                             unsigned int timeout) const {
 	assert((endpoint & LIBUSB_ENDPOINT_IN) == 0);
+	return pimpl->bulkTransferOut(endpoint, data.data(), data.size(), timeout);
+}
+
+int Device::bulkTransferOut(unsigned char endpoint,
+                            const BufferChain& data,
+                            unsigned int timeout) const {
+	assert((endpoint & LIBUSB_ENDPOINT_IN) == 0);
+	if (data.size() > INT_MAX) {
+		throw DeviceTransferException(LIBUSB_ERROR_INVALID_PARAM);
+	}
+	// only the last segment may end with a short packet
+	int maxPacketSize(libusb_get_max_packet_size(pimpl->m_device, endpoint));
+	bool direct(maxPacketSize > 0);
+	for (std::size_t i = 0; direct && i + 1 < data.getSegmentCount(); i++) {
+		direct = data.getSegment(i).size() % maxPacketSize == 0;
+	}
+	if (! direct) {
+		ByteBuffer buffer(data.toBuffer());
+		return pimpl->bulkTransferOut(endpoint, buffer.data(), buffer.size(), timeout);
+	}
+
 	int transferred(0);
-	int res = libusb_bulk_transfer(pimpl->m_handle, endpoint,
-	                               const_cast<unsigned char*>(data.data()), data.size(), &transferred, timeout);
-	if (res != 0) {
-		throw DeviceTransferException(res);
+	for (std::size_t i = 0; i < data.getSegmentCount(); i++) {
+		const SharedBuffer& segment(data.getSegment(i));
+		int sent(pimpl->bulkTransferOut(endpoint, segment.data(), segment.size(), timeout));
+		transferred += sent;
+		if (static_cast<std::size_t>(sent) != segment.size()) {
+			break;
+		}
 	}
 	return transferred;
 }
@@ -326,4 +618,76 @@ int Device::interruptTransferOut(unsigned char endpoint,
 	return transferred;
 }
 
+void Device::bulkTransferInAsync(unsigned char endpoint,
+                                 ByteBuffer& data,
+                                 unsigned int timeout,
+                                 const TransferCallback& callback) const {
+	assert(endpoint & LIBUSB_ENDPOINT_IN);
+	pimpl->submitTransfer(LIBUSB_TRANSFER_TYPE_BULK, endpoint, data.data(), data.size(), timeout, callback);
+}
+
+void Device::interruptTransferInAsync(unsigned char endpoint,
+                                      ByteBuffer& data,
+                                      unsigned int timeout,
+                                      const TransferCallback& callback) const {
+	assert(endpoint & LIBUSB_ENDPOINT_IN);
+	pimpl->submitTransfer(LIBUSB_TRANSFER_TYPE_INTERRUPT, endpoint, data.data(), data.size(), timeout, callback);
+}
+
+void Device::bulkTransferOutAsync(unsigned char endpoint,
+                                  const ByteBuffer& data,
+                                  unsigned int timeout,
+                                  const TransferCallback& callback) const {
+	assert((endpoint & LIBUSB_ENDPOINT_IN) == 0);
+	pimpl->submitTransfer(LIBUSB_TRANSFER_TYPE_BULK, endpoint,
+	                      const_cast<unsigned char*>(data.data()), data.size(), timeout, callback);
+}
+
+void Device::interruptTransferOutAsync(unsigned char endpoint,
+                                       const ByteBuffer& data,
+                                       unsigned int timeout,
+                                       const TransferCallback& callback) const {
+	assert((endpoint & LIBUSB_ENDPOINT_IN) == 0);
+	pimpl->submitTransfer(LIBUSB_TRANSFER_TYPE_INTERRUPT, endpoint,
+	                      const_cast<unsigned char*>(data.data()), data.size(), timeout, callback);
+}
+
+void Device::controlTransferInAsync(uint8_t bmRequestType,
+                                    uint8_t bRequest,
+                                    uint16_t wValue,
+                                    uint16_t wIndex,
+                                    ByteBuffer& data,
+                                    unsigned int timeout,
+                                    const TransferCallback& callback) const {
+	assert(bmRequestType & LIBUSB_ENDPOINT_IN);
+	// the control transfer needs room for the setup packet in front of the data
+	std::shared_ptr<ByteBuffer> buffer(std::make_shared<ByteBuffer>(LIBUSB_CONTROL_SETUP_SIZE + data.size()));
+	libusb_fill_control_setup(buffer->data(), bmRequestType, bRequest, wValue, wIndex, data.size());
+	ByteBuffer* target(&data);
+	pimpl->submitTransfer(LIBUSB_TRANSFER_TYPE_CONTROL, 0, buffer->data(), buffer->size(), timeout,
+	                      [buffer, target, callback](int error, int transferred) {
+		std::copy(buffer->data() + LIBUSB_CONTROL_SETUP_SIZE,
+		          buffer->data() + LIBUSB_CONTROL_SETUP_SIZE + transferred,
+		          target->data());
+		callback(error, transferred);
+	});
+}
+
+void Device::controlTransferOutAsync(uint8_t bmRequestType,
+                                     uint8_t bRequest,
+                                     uint16_t wValue,
+                                     uint16_t wIndex,
+                                     const ByteBuffer& data,
+                                     unsigned int timeout,
+                                     const TransferCallback& callback) const {
+	assert((bmRequestType & LIBUSB_ENDPOINT_IN) == 0);
+	std::shared_ptr<ByteBuffer> buffer(std::make_shared<ByteBuffer>(LIBUSB_CONTROL_SETUP_SIZE + data.size()));
+	libusb_fill_control_setup(buffer->data(), bmRequestType, bRequest, wValue, wIndex, data.size());
+	std::copy(data.data(), data.data() + data.size(), buffer->data() + LIBUSB_CONTROL_SETUP_SIZE);
+	pimpl->submitTransfer(LIBUSB_TRANSFER_TYPE_CONTROL, 0, buffer->data(), buffer->size(), timeout,
+	                      [buffer, callback](int error, int transferred) {
+		callback(error, transferred);
+	});
+}
+
 }
@@ -27,13 +27,45 @@ namespace Usbpp {
 class Device::Impl {
 public:
 	Impl();
-	explicit Impl(libusb_device* device_);
+	Impl(libusb_device* device_, libusb_context* context);
 	Impl(const Impl& other);
 	~Impl();
 
 	void close();
 	void releaseInterface(int bInterfaceNumber);
 
+	/**
+	 * Submit an asynchronous transfer.
+	 *
+	 * \param type libusb_transfer_type of the transfer
+	 */
+	void submitTransfer(unsigned char type,
+	                    unsigned char endpoint,
+	                    unsigned char* data,
+	                    int length,
+	                    unsigned int timeout,
+	                    const TransferCallback& callback) const;
+
+	/**
+	 * Synchronous bulk transfer split into chunks kept in flight concurrently.
+	 *
+	 * \return number of bytes transferred
+	 */
+	int chunkedBulkTransfer(unsigned char endpoint,
+	                        unsigned char* data,
+	                        std::size_t length,
+	                        unsigned int timeout) const;
+	/**
+	 * Synchronous bulk transfer from computer to device.
+	 *
+	 * \return number of bytes transferred
+	 */
+	int bulkTransferOut(unsigned char endpoint,
+	                    const std::uint8_t* data,
+	                    std::size_t length,
+	                    unsigned int timeout) const;
+
+	libusb_context* m_context;
 	libusb_device* m_device;
 	libusb_device_handle* m_handle;
 	int* m_handleRefCount;
@@ -41,6 +73,15 @@ public:
 	std::unordered_set<int> m_interfaceMyClaimed;
 	// a shared map storing the reference counts for all interfaces
 	std::unordered_map<int, int>* m_interfaceRefCount;
+	// splitting of the large bulk transfers
+	std::size_t m_chunkSize;
+	unsigned int m_chunkDepth;
+	bool m_chunkIn;
 };
 
+/**
+ * Convert the status of a finished transfer to a libusb error.
+ */
+int getTransferError(libusb_transfer_status status);
+
 }
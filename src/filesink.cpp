@@ -0,0 +1,310 @@
+/*
+ * This file is part of Usbpp, a C++ wrapper around libusb
+ * Copyright (C) 2016  Lukas Jirkovsky <l.jirkovsky @at@ gmail.com>
+ *
+ * Usbpp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, version 3 of the License
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "filesink.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <deque>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace {
+
+/**
+ * A file being written by the sink
+ */
+struct MappedFile {
+	int fd;
+	std::uint8_t* base;
+	// offset up to which the file has been grown
+	std::uint64_t grown;
+	// offset of the next claimed buffer
+	std::uint64_t claimOffset;
+	// end of the stored data
+	std::uint64_t writeOffset;
+	// offset up to which the write-out has been started
+	std::uint64_t flushed;
+	// number of claimed buffers that were not committed yet
+	unsigned int pendingClaims;
+	std::chrono::steady_clock::time_point opened;
+};
+
+/**
+ * A buffer claimed from the sink
+ */
+struct Claim {
+	MappedFile* file;
+	std::uint64_t offset;
+};
+
+std::uint64_t roundUp(std::uint64_t value, std::uint64_t multiple) {
+	return (value + multiple - 1) / multiple * multiple;
+}
+
+}
+
+namespace Usbpp {
+
+FileSinkException::FileSinkException(int error) noexcept : Exception(error) {
+
+}
+
+FileSinkException::~FileSinkException() {
+
+}
+
+const char* FileSinkException::what() const noexcept {
+	return "Cannot write the stream file!";
+}
+
+std::string FileSinkException::getDescription() const {
+	return std::string(what()) + " Caused by: " + std::strerror(getError());
+}
+
+class FileSink::Impl {
+public:
+	Impl(const std::string& path, std::size_t transferSize, std::uint64_t maxFileSize, std::size_t growStep);
+	~Impl();
+
+	/**
+	 * Create and map the next file
+	 */
+	void openFile();
+	/**
+	 * Unmap the file, truncate it to the size of its data and close it
+	 */
+	void closeFile(MappedFile& file);
+	/**
+	 * Close the rotated files that have no claimed buffers left
+	 */
+	void closeIdleFiles();
+	/**
+	 * Grow the file so that it has at least \a end bytes
+	 *
+	 * \return errno or 0 on success
+	 */
+	int grow(MappedFile& file, std::uint64_t end);
+	/**
+	 * Start writing out the completed parts of the file and release the
+	 * parts whose write-out has been started before
+	 */
+	void writeOut(MappedFile& file);
+
+	std::string m_path;
+	std::size_t m_transferSize;
+	std::uint64_t m_maxFileSize;
+	std::uint64_t m_growStep;
+	std::uint64_t m_writeOutChunk;
+	std::atomic<std::int64_t> m_rotationInterval;
+	// the last file is the current one, the others are kept until their claims are committed
+	std::deque<MappedFile> m_files;
+	std::deque<Claim> m_claims;
+	// statistics
+	std::atomic<std::uint64_t> m_bytesWritten;
+	std::atomic<std::uint64_t> m_bytesMoved;
+	std::atomic<std::uint64_t> m_dropped;
+	std::atomic<std::uint64_t> m_droppedBytes;
+	std::atomic<std::uint64_t> m_fileCount;
+	std::atomic<int> m_lastError;
+};
+
+FileSink::Impl::Impl(const std::string& path, std::size_t transferSize, std::uint64_t maxFileSize, std::size_t growStep) :
+	m_path(path),
+	m_transferSize(transferSize),
+	m_rotationInterval(0),
+	m_bytesWritten(0),
+	m_bytesMoved(0),
+	m_dropped(0),
+	m_droppedBytes(0),
+	m_fileCount(0),
+	m_lastError(0) {
+
+	std::uint64_t pageSize(sysconf(_SC_PAGESIZE));
+	m_growStep = roundUp(std::max<std::uint64_t>(growStep, 1), pageSize);
+	m_writeOutChunk = std::min<std::uint64_t>(m_growStep, 8 << 20);
+	m_maxFileSize = roundUp(std::max<std::uint64_t>(maxFileSize, transferSize), pageSize);
+	openFile();
+}
+
+FileSink::Impl::~Impl() {
+	for (MappedFile& file : m_files) {
+		closeFile(file);
+	}
+}
+
+void FileSink::Impl::openFile() {
+	std::uint64_t index(m_fileCount);
+	std::string path(index == 0 ? m_path : m_path + "." + std::to_string(index));
+
+	MappedFile file;
+	file.fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (file.fd < 0) {
+		throw FileSinkException(errno);
+	}
+	// reserve the address space for the whole file, the file itself is grown later
+	void* base(mmap(nullptr, m_maxFileSize, PROT_READ | PROT_WRITE, MAP_SHARED, file.fd, 0));
+	if (base == MAP_FAILED) {
+		int error(errno);
+		close(file.fd);
+		throw FileSinkException(error);
+	}
+	file.base = static_cast<std::uint8_t*>(base);
+	file.grown = 0;
+	file.claimOffset = 0;
+	file.writeOffset = 0;
+	file.flushed = 0;
+	file.pendingClaims = 0;
+	file.opened = std::chrono::steady_clock::now();
+	m_files.push_back(file);
+	++m_fileCount;
+}
+
+void FileSink::Impl::closeFile(MappedFile& file) {
+	munmap(file.base, m_maxFileSize);
+	if (ftruncate(file.fd, file.writeOffset) != 0) {
+		m_lastError = errno;
+	}
+	close(file.fd);
+}
+
+void FileSink::Impl::closeIdleFiles() {
+	while (m_files.size() > 1 && m_files.front().pendingClaims == 0) {
+		closeFile(m_files.front());
+		m_files.pop_front();
+	}
+}
+
+int FileSink::Impl::grow(MappedFile& file, std::uint64_t end) {
+	// stay one step ahead of the data
+	std::uint64_t size(std::min(roundUp(end, m_growStep) + m_growStep, m_maxFileSize));
+	int res(posix_fallocate(file.fd, file.grown, size - file.grown));
+	if (res != 0) {
+		// the file system may not support allocation, just extend the file
+		if (ftruncate(file.fd, size) != 0) {
+			return errno;
+		}
+	}
+	file.grown = size;
+	return 0;
+}
+
+void FileSink::Impl::writeOut(MappedFile& file) {
+	while (file.writeOffset - file.flushed >= m_writeOutChunk) {
+		sync_file_range(file.fd, file.flushed, m_writeOutChunk, SYNC_FILE_RANGE_WRITE);
+		// the write-out of the previous chunk has been started already, release its pages
+		if (file.flushed >= m_writeOutChunk) {
+			madvise(file.base + file.flushed - m_writeOutChunk, m_writeOutChunk, MADV_DONTNEED);
+		}
+		file.flushed += m_writeOutChunk;
+	}
+}
+
+FileSink::FileSink(const std::string& path, std::size_t transferSize, std::uint64_t maxFileSize, std::size_t growStep) :
+	pimpl(new Impl(path, transferSize, maxFileSize, growStep)) {
+
+}
+
+FileSink::~FileSink() {
+
+}
+
+std::uint8_t* FileSink::claim(std::size_t& size) {
+	MappedFile* file(&pimpl->m_files.back());
+	std::size_t claimSize(size == 0 ? pimpl->m_transferSize : std::min<std::uint64_t>(size, pimpl->m_maxFileSize));
+
+	std::chrono::seconds interval(pimpl->m_rotationInterval);
+	bool expired(interval.count() > 0 && file->claimOffset > 0 &&
+	             std::chrono::steady_clock::now() - file->opened >= interval);
+	if (expired || file->claimOffset + claimSize > pimpl->m_maxFileSize) {
+		try {
+			pimpl->openFile();
+		}
+		catch (const FileSinkException& e) {
+			pimpl->m_lastError = e.getError();
+			return nullptr;
+		}
+		pimpl->closeIdleFiles();
+		file = &pimpl->m_files.back();
+	}
+
+	if (file->claimOffset + claimSize > file->grown) {
+		int error(pimpl->grow(*file, file->claimOffset + claimSize));
+		if (error != 0) {
+			pimpl->m_lastError = error;
+			return nullptr;
+		}
+	}
+
+	Claim claim;
+	claim.file = file;
+	claim.offset = file->claimOffset;
+	pimpl->m_claims.push_back(claim);
+	file->claimOffset += claimSize;
+	++file->pendingClaims;
+
+	size = claimSize;
+	return file->base + claim.offset;
+}
+
+void FileSink::commit(std::size_t length) {
+	Claim claim(pimpl->m_claims.front());
+	pimpl->m_claims.pop_front();
+
+	MappedFile& file(*claim.file);
+	if (claim.offset != file.writeOffset && length > 0) {
+		// a previous transfer was short, close the gap
+		std::memmove(file.base + file.writeOffset, file.base + claim.offset, length);
+		pimpl->m_bytesMoved += length;
+	}
+	file.writeOffset += length;
+	--file.pendingClaims;
+	if (file.pendingClaims == 0) {
+		// nothing is in flight, the next transfer can land in place again
+		file.claimOffset = file.writeOffset;
+	}
+	pimpl->m_bytesWritten += length;
+
+	pimpl->writeOut(file);
+	pimpl->closeIdleFiles();
+}
+
+void FileSink::drop(std::size_t length) {
+	++pimpl->m_dropped;
+	pimpl->m_droppedBytes += length;
+}
+
+void FileSink::setRotationInterval(std::chrono::seconds interval) {
+	pimpl->m_rotationInterval = interval.count();
+}
+
+FileSinkStatistics FileSink::getStatistics() const {
+	FileSinkStatistics stats;
+	stats.bytesWritten = pimpl->m_bytesWritten;
+	stats.bytesMoved = pimpl->m_bytesMoved;
+	stats.dropped = pimpl->m_dropped;
+	stats.droppedBytes = pimpl->m_droppedBytes;
+	stats.files = pimpl->m_fileCount;
+	stats.lastError = pimpl->m_lastError;
+	return stats;
+}
+
+}
@@ -0,0 +1,160 @@
+/*
+ * This file is part of Usbpp, a C++ wrapper around libusb
+ * Copyright (C) 2016  Lukas Jirkovsky <l.jirkovsky @at@ gmail.com>
+ *
+ * Usbpp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, version 3 of the License
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "filesource.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <deque>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace Usbpp {
+
+FileSourceException::FileSourceException(int error) noexcept : Exception(error) {
+
+}
+
+FileSourceException::~FileSourceException() {
+
+}
+
+const char* FileSourceException::what() const noexcept {
+	return "Cannot read the stream file!";
+}
+
+std::string FileSourceException::getDescription() const {
+	return std::string(what()) + " Caused by: " + std::strerror(getError());
+}
+
+class FileSource::Impl {
+public:
+	Impl(const std::string& path, std::size_t windowSize);
+	~Impl();
+
+	/**
+	 * Give a hint to the kernel about the intended use of a part of the file
+	 */
+	void advise(std::uint64_t offset, std::uint64_t length, int advice);
+
+	int m_fd;
+	std::uint8_t* m_base;
+	std::uint64_t m_size;
+	std::uint64_t m_pageSize;
+	std::uint64_t m_windowSize;
+	// offset of the next window to send
+	std::uint64_t m_nextOffset;
+	// offset of the oldest window in flight
+	std::atomic<std::uint64_t> m_releasedOffset;
+	// sizes of the windows in flight
+	std::deque<std::uint64_t> m_inFlight;
+};
+
+FileSource::Impl::Impl(const std::string& path, std::size_t windowSize) :
+	m_base(nullptr),
+	m_nextOffset(0),
+	m_releasedOffset(0) {
+
+	m_pageSize = sysconf(_SC_PAGESIZE);
+	m_windowSize = (std::max<std::uint64_t>(windowSize, 1) + m_pageSize - 1) / m_pageSize * m_pageSize;
+
+	m_fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (m_fd < 0) {
+		throw FileSourceException(errno);
+	}
+	struct stat info;
+	if (fstat(m_fd, &info) != 0) {
+		int error(errno);
+		close(m_fd);
+		throw FileSourceException(error);
+	}
+	m_size = info.st_size;
+
+	if (m_size > 0) {
+		void* base(mmap(nullptr, m_size, PROT_READ, MAP_SHARED, m_fd, 0));
+		if (base == MAP_FAILED) {
+			int error(errno);
+			close(m_fd);
+			throw FileSourceException(error);
+		}
+		m_base = static_cast<std::uint8_t*>(base);
+		madvise(m_base, m_size, MADV_SEQUENTIAL);
+	}
+}
+
+FileSource::Impl::~Impl() {
+	if (m_base != nullptr) {
+		munmap(m_base, m_size);
+	}
+	close(m_fd);
+}
+
+void FileSource::Impl::advise(std::uint64_t offset, std::uint64_t length, int advice) {
+	if (offset < m_size) {
+		madvise(m_base + offset, std::min(length, m_size - offset), advice);
+	}
+}
+
+FileSource::FileSource(const std::string& path, std::size_t windowSize) :
+	pimpl(new Impl(path, windowSize)) {
+
+}
+
+FileSource::~FileSource() {
+
+}
+
+const std::uint8_t* FileSource::next(std::size_t& size) {
+	std::uint64_t offset(pimpl->m_nextOffset);
+	if (offset >= pimpl->m_size) {
+		return nullptr;
+	}
+	// keep the windows aligned to the pages
+	std::uint64_t windowSize(pimpl->m_windowSize);
+	if (size != 0) {
+		windowSize = (size + pimpl->m_pageSize - 1) / pimpl->m_pageSize * pimpl->m_pageSize;
+	}
+	size = std::min(windowSize, pimpl->m_size - offset);
+	pimpl->m_nextOffset += size;
+	pimpl->m_inFlight.push_back(size);
+	// read the following window while this one is being sent
+	pimpl->advise(pimpl->m_nextOffset, windowSize, MADV_WILLNEED);
+	return pimpl->m_base + offset;
+}
+
+void FileSource::release(std::size_t) {
+	std::uint64_t offset(pimpl->m_releasedOffset);
+	std::uint64_t size(pimpl->m_inFlight.front());
+	pimpl->m_inFlight.pop_front();
+	pimpl->advise(offset, size, MADV_DONTNEED);
+	pimpl->m_releasedOffset = offset + size;
+}
+
+std::uint64_t FileSource::getSize() const {
+	return pimpl->m_size;
+}
+
+std::uint64_t FileSource::getBytesReleased() const {
+	return pimpl->m_releasedOffset;
+}
+
+}
@@ -0,0 +1,226 @@
+/*
+ * This file is part of Usbpp, a C++ wrapper around libusb
+ * Copyright (C) 2016  Lukas Jirkovsky <l.jirkovsky @at@ gmail.com>
+ *
+ * Usbpp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, version 3 of the License
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "hiddecoder.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "wireformat.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define USBPP_HID_AVX2
+#include <immintrin.h>
+#endif
+
+namespace {
+
+using Usbpp::HID::DecodeProgram;
+
+inline std::uint16_t load16(const std::uint8_t* data) {
+	std::uint16_t value;
+	std::memcpy(&value, data, sizeof(value));
+	if (Usbpp::WireFormat::Detail::HostEndian != Usbpp::WireFormat::Endian::LITTLE) {
+		value = Usbpp::WireFormat::Detail::byteSwap(value);
+	}
+	return value;
+}
+
+inline std::uint32_t load32(const std::uint8_t* data) {
+	std::uint32_t value;
+	std::memcpy(&value, data, sizeof(value));
+	if (Usbpp::WireFormat::Detail::HostEndian != Usbpp::WireFormat::Endian::LITTLE) {
+		value = Usbpp::WireFormat::Detail::byteSwap(value);
+	}
+	return value;
+}
+
+/**
+ * Store the values of a block of packed fields.
+ */
+inline void storeBlock(const DecodeProgram::Packed& packed, std::size_t first, const std::int32_t* lanes, std::int32_t* values) {
+	if (packed.contiguous[first / DecodeProgram::PackedBlock]) {
+		std::memcpy(values + packed.indices[first], lanes, DecodeProgram::PackedBlock * sizeof(std::int32_t));
+		return;
+	}
+	for (std::size_t lane = 0; lane < DecodeProgram::PackedBlock && first + lane < packed.count; lane++) {
+		values[packed.indices[first + lane]] = lanes[lane];
+	}
+}
+
+/**
+ * Extract the packed fields using 32-bit word operations.
+ */
+void runPackedScalar(const DecodeProgram::Packed& packed, const std::uint8_t* report, std::int32_t* values) {
+	for (std::size_t first = 0; first < packed.count; first += DecodeProgram::PackedBlock) {
+		std::int32_t lanes[DecodeProgram::PackedBlock];
+		for (std::size_t lane = 0; lane < DecodeProgram::PackedBlock; lane++) {
+			std::size_t i(first + lane);
+			// move the field to the top of the word and shift it back
+			std::uint32_t top(load32(report + packed.byteOffsets[i]) >> packed.shifts[i] << packed.topShifts[i]);
+			if (packed.signMasks[i] != 0) {
+				lanes[lane] = static_cast<std::int32_t>(top) >> packed.topShifts[i];
+			}
+			else {
+				lanes[lane] = static_cast<std::int32_t>(top >> packed.topShifts[i]);
+			}
+		}
+		storeBlock(packed, first, lanes, values);
+	}
+}
+
+#ifdef USBPP_HID_AVX2
+/**
+ * Extract the packed fields using AVX2, one block per iteration.
+ */
+__attribute__((target("avx2")))
+void runPackedAvx2(const DecodeProgram::Packed& packed, const std::uint8_t* report, std::int32_t* values) {
+	for (std::size_t first = 0; first < packed.count; first += DecodeProgram::PackedBlock) {
+		__m256i offsets(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(&packed.byteOffsets[first])));
+		__m256i shifts(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(&packed.shifts[first])));
+		__m256i topShifts(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(&packed.topShifts[first])));
+		__m256i signMasks(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(&packed.signMasks[first])));
+
+		__m256i words(_mm256_i32gather_epi32(reinterpret_cast<const int*>(report), offsets, 1));
+		__m256i top(_mm256_sllv_epi32(_mm256_srlv_epi32(words, shifts), topShifts));
+		__m256i result(_mm256_blendv_epi8(_mm256_srlv_epi32(top, topShifts),
+		                                  _mm256_srav_epi32(top, topShifts),
+		                                  signMasks));
+
+		if (packed.contiguous[first / DecodeProgram::PackedBlock]) {
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(values + packed.indices[first]), result);
+		}
+		else {
+			std::int32_t lanes[DecodeProgram::PackedBlock];
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes), result);
+			storeBlock(packed, first, lanes, values);
+		}
+	}
+}
+#endif
+
+typedef void (*PackedKernel)(const DecodeProgram::Packed& packed, const std::uint8_t* report, std::int32_t* values);
+
+PackedKernel selectKernel() {
+#ifdef USBPP_HID_AVX2
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")) {
+		return runPackedAvx2;
+	}
+#endif
+	return runPackedScalar;
+}
+
+PackedKernel packedKernel() {
+	static const PackedKernel kernel(selectKernel());
+	return kernel;
+}
+
+}
+
+namespace Usbpp {
+namespace HID {
+
+const std::size_t DecodeProgram::PackedBlock;
+
+DecodeProgram::DecodeProgram() : m_readLength(0) {
+	m_packed.count = 0;
+}
+
+DecodeProgram::DecodeProgram(const std::vector<ReportField>& fields) : m_readLength(0) {
+	m_packed.count = 0;
+	// the bytes actually occupied by the fields, a full-length report has at least as many
+	for (const ReportField& field : fields) {
+		m_readLength = std::max<std::size_t>(m_readLength, (field.bitOffset + field.bitSize + 7) / 8);
+	}
+
+	for (std::size_t i = 0; i < fields.size(); i++) {
+		const ReportField& field(fields[i]);
+		std::uint32_t byteOffset(field.bitOffset / 8);
+		std::uint32_t shift(field.bitOffset % 8);
+		if (shift == 0 && (field.bitSize == 8 || field.bitSize == 16 || field.bitSize == 32)) {
+			Direct direct;
+			direct.byteOffset = byteOffset;
+			direct.index = i;
+			direct.bytes = field.bitSize / 8;
+			direct.isSigned = field.isSigned;
+			m_direct.push_back(direct);
+		}
+		else if (shift + field.bitSize <= 32 && byteOffset + 4 <= m_readLength) {
+			m_packed.byteOffsets.push_back(byteOffset);
+			m_packed.shifts.push_back(shift);
+			m_packed.topShifts.push_back(32 - field.bitSize);
+			m_packed.signMasks.push_back(field.isSigned ? -1 : 0);
+			m_packed.indices.push_back(i);
+			m_packed.count++;
+		}
+		else {
+			m_single.push_back(field);
+			m_singleIndices.push_back(i);
+		}
+	}
+
+	// pad the last block with fields reading the first word
+	while (m_packed.byteOffsets.size() % PackedBlock != 0) {
+		m_packed.byteOffsets.push_back(0);
+		m_packed.shifts.push_back(0);
+		m_packed.topShifts.push_back(0);
+		m_packed.signMasks.push_back(0);
+		m_packed.indices.push_back(0);
+	}
+	for (std::size_t first = 0; first < m_packed.count; first += PackedBlock) {
+		bool contiguous(first + PackedBlock <= m_packed.count);
+		for (std::size_t lane = 1; contiguous && lane < PackedBlock; lane++) {
+			contiguous = m_packed.indices[first + lane] == m_packed.indices[first] + lane;
+		}
+		m_packed.contiguous.push_back(contiguous);
+	}
+}
+
+void DecodeProgram::run(const std::uint8_t* report, std::int32_t* values) const {
+	for (const Direct& direct : m_direct) {
+		const std::uint8_t* data(report + direct.byteOffset);
+		switch (direct.bytes) {
+			case 1:
+				values[direct.index] = direct.isSigned ? static_cast<std::int8_t>(*data) : *data;
+				break;
+			case 2:
+				values[direct.index] = direct.isSigned ? static_cast<std::int16_t>(load16(data)) : load16(data);
+				break;
+			default:
+				values[direct.index] = static_cast<std::int32_t>(load32(data));
+				break;
+		}
+	}
+	if (m_packed.count != 0) {
+		packedKernel()(m_packed, report, values);
+	}
+	for (std::size_t i = 0; i < m_single.size(); i++) {
+		values[m_singleIndices[i]] = ReportLayout::extract(ByteBufferView(report, m_readLength), m_single[i]);
+	}
+}
+
+std::size_t DecodeProgram::getReadLength() const {
+	return m_readLength;
+}
+
+bool DecodeProgram::isVectorized() {
+	return packedKernel() != runPackedScalar;
+}
+
+}
+}
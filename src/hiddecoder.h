@@ -0,0 +1,103 @@
+/*
+ * This file is part of Usbpp, a C++ wrapper around libusb
+ * Copyright (C) 2016  Lukas Jirkovsky <l.jirkovsky @at@ gmail.com>
+ *
+ * Usbpp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, version 3 of the License
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBUSBPP_HID_DECODER_H_
+#define LIBUSBPP_HID_DECODER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "hidlayout.h"
+
+namespace Usbpp {
+namespace HID {
+
+/**
+ * Fields of a report sorted by the way they are extracted.
+ *
+ * The byte-aligned fields of 8, 16 and 32 bits are read by direct loads.
+ * The other fields that fit in a 32-bit word after shifting are packed
+ * in blocks of PackedBlock fields, stored as a structure of arrays,
+ * so that a whole block can be extracted at once using SIMD instructions.
+ * The few remaining fields (the wide ones and those whose word would reach
+ * past the end of the report) are extracted one by one, so the program never
+ * reads past the last byte occupied by the fields.
+ */
+class DecodeProgram {
+public:
+	static const std::size_t PackedBlock = 8;
+
+	DecodeProgram();
+
+	/**
+	 * Compile the program for the fields of a report.
+	 */
+	explicit DecodeProgram(const std::vector<ReportField>& fields);
+
+	/**
+	 * Decode the fields.
+	 *
+	 * \param report the report, at least getReadLength() bytes long
+	 * \param values receives the value of each field
+	 */
+	void run(const std::uint8_t* report, std::int32_t* values) const;
+
+	/**
+	 * Get the number of bytes the program may read from a report.
+	 */
+	std::size_t getReadLength() const;
+
+	/**
+	 * Whether the packed fields are extracted using SIMD instructions.
+	 */
+	static bool isVectorized();
+
+	struct Direct {
+		std::uint32_t byteOffset;
+		std::uint32_t index;
+		std::uint8_t bytes;
+		bool isSigned;
+	};
+
+	struct Packed {
+		// one entry per field, padded to a multiple of PackedBlock
+		std::vector<std::int32_t> byteOffsets;
+		std::vector<std::int32_t> shifts;
+		// 32 - bitSize, the shift moving the top bit of the field to bit 31
+		std::vector<std::int32_t> topShifts;
+		// -1 for the signed fields
+		std::vector<std::int32_t> signMasks;
+		std::vector<std::uint32_t> indices;
+		// whether the indices of a block are consecutive
+		std::vector<bool> contiguous;
+		std::size_t count;
+	};
+
+private:
+	std::vector<Direct> m_direct;
+	Packed m_packed;
+	// fields extracted one by one
+	std::vector<ReportField> m_single;
+	std::vector<std::uint32_t> m_singleIndices;
+	std::size_t m_readLength;
+};
+
+}
+}
+
+#endif
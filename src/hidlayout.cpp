@@ -0,0 +1,319 @@
+/*
+ * This file is part of Usbpp, a C++ wrapper around libusb
+ * Copyright (C) 2016  Lukas Jirkovsky <l.jirkovsky @at@ gmail.com>
+ *
+ * Usbpp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, version 3 of the License
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "hidlayout.h"
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <utility>
+
+#include "hiddecoder.h"
+#include "wireformat.h"
+
+namespace {
+
+using Usbpp::HID::ReportItem;
+using Usbpp::HID::ReportNode;
+
+const std::size_t ReportTypes = 3;
+const std::size_t ReportIds = 256;
+
+/**
+ * Get the index of the tables of a report type.
+ *
+ * \return the index or ReportTypes if the main item doesn't define a report
+ */
+std::size_t typeIndex(ReportItem::TagsMain type) {
+	switch (type) {
+		case ReportItem::TagsMain::INPUT:
+			return 0;
+		case ReportItem::TagsMain::OUTPUT:
+			return 1;
+		case ReportItem::TagsMain::FEATURE:
+			return 2;
+		default:
+			return ReportTypes;
+	}
+}
+
+/**
+ * Get an unsigned global item, 0 if it is not present.
+ */
+std::uint32_t globalUnsigned(const ReportNode& node, ReportItem::TagsGlobal tag) {
+	ReportNode::GlobalItemMap::const_iterator it(node.getGlobalState().find(tag));
+	return it != node.getGlobalState().end() ? it->second.getUnsigned() : 0;
+}
+
+/**
+ * Get a usage with the usage page, the usage items with 4 bytes of data
+ * contain the usage page already.
+ */
+std::uint32_t fullUsage(const ReportItem& item, std::uint32_t usagePage) {
+	if (item.getDataSize() == 4) {
+		return item.getUnsigned();
+	}
+	return (usagePage << 16) | item.getUnsigned();
+}
+
+/**
+ * Fields of a single report.
+ */
+struct ReportTable {
+	ReportTable() : bitLength(0) {
+
+	}
+
+	std::vector<Usbpp::HID::ReportField> fields;
+	std::uint32_t bitLength;
+	Usbpp::HID::DecodeProgram program;
+};
+
+}
+
+namespace Usbpp {
+namespace HID {
+
+class ReportLayout::Impl {
+public:
+	Impl();
+
+	/**
+	 * Add the fields of a main item.
+	 */
+	void addItem(const ReportNode& node);
+
+	bool m_reportIds;
+	// tables indexed by the report type and Report ID
+	std::vector<ReportTable> m_tables[ReportTypes];
+};
+
+ReportLayout::Impl::Impl() : m_reportIds(false) {
+	for (std::vector<ReportTable>& tables : m_tables) {
+		tables.resize(ReportIds);
+	}
+}
+
+void ReportLayout::Impl::addItem(const ReportNode& node) {
+	const ReportItem& item(node.getItem());
+	std::size_t type(typeIndex(static_cast<ReportItem::TagsMain>(item.getTag())));
+	if (item.getType() != ReportItem::Type::MAIN || type == ReportTypes) {
+		return;
+	}
+
+	std::uint8_t reportId(globalUnsigned(node, ReportItem::TagsGlobal::REPORT_ID) & 0xFF);
+	std::uint32_t reportSize(globalUnsigned(node, ReportItem::TagsGlobal::REPORT_SIZE));
+	std::uint32_t reportCount(globalUnsigned(node, ReportItem::TagsGlobal::REPORT_COUNT));
+	std::uint32_t usagePage(globalUnsigned(node, ReportItem::TagsGlobal::USAGE_PAGE));
+	std::uint32_t flags(item.getUnsigned());
+
+	ReportTable& table(m_tables[type][reportId]);
+	if (table.bitLength == 0 && m_reportIds) {
+		// skip the Report ID byte
+		table.bitLength = 8;
+	}
+	std::uint32_t offset(table.bitLength);
+	table.bitLength += reportSize * reportCount;
+	// constant items are just padding
+	if ((flags & 0x1) != 0 || reportSize == 0) {
+		return;
+	}
+
+	ReportField field;
+	field.bitSize = std::min<std::uint32_t>(reportSize, 32);
+	field.isArray = (flags & 0x2) == 0;
+	field.flags = flags;
+	const ReportNode::GlobalItemMap& globals(node.getGlobalState());
+	ReportNode::GlobalItemMap::const_iterator minimum(globals.find(ReportItem::TagsGlobal::LOGICAL_MINIMUM));
+	ReportNode::GlobalItemMap::const_iterator maximum(globals.find(ReportItem::TagsGlobal::LOGICAL_MAXIMUM));
+	field.logicalMinimum = minimum != globals.end() ? minimum->second.getSigned() : 0;
+	// the maximum is often encoded without the sign bit when the minimum is not negative
+	if (maximum == globals.end()) {
+		field.logicalMaximum = 0;
+	}
+	else if (field.logicalMinimum >= 0) {
+		field.logicalMaximum = static_cast<std::int32_t>(maximum->second.getUnsigned());
+	}
+	else {
+		field.logicalMaximum = maximum->second.getSigned();
+	}
+	field.isSigned = field.logicalMinimum < 0;
+
+	// usages
+	const std::vector<ReportItem>& usages(node.getUsages());
+	const ReportNode::LocalItemMap& locals(node.getLocalState());
+	ReportNode::LocalItemMap::const_iterator usageMinimum(locals.find(ReportItem::TagsLocal::USAGE_MINIMUM));
+	ReportNode::LocalItemMap::const_iterator usageMaximum(locals.find(ReportItem::TagsLocal::USAGE_MAXIMUM));
+	std::uint32_t rangeMinimum(0);
+	std::uint32_t rangeMaximum(0);
+	bool range(usageMinimum != locals.end());
+	if (range) {
+		rangeMinimum = fullUsage(usageMinimum->second, usagePage);
+		rangeMaximum = usageMaximum != locals.end() ? fullUsage(usageMaximum->second, usagePage) : rangeMinimum;
+	}
+
+	for (std::uint32_t i = 0; i < reportCount; i++) {
+		field.bitOffset = offset + i * reportSize;
+		if (field.isArray) {
+			field.usage = range ? rangeMinimum : (usages.empty() ? 0 : fullUsage(usages.front(), usagePage));
+			field.usageMaximum = range ? rangeMaximum : (usages.empty() ? 0 : fullUsage(usages.back(), usagePage));
+		}
+		else {
+			if (! usages.empty()) {
+				// the last usage applies to all the remaining fields
+				field.usage = fullUsage(usages[std::min<std::size_t>(i, usages.size() - 1)], usagePage);
+			}
+			else if (range) {
+				field.usage = std::min(rangeMinimum + i, rangeMaximum);
+			}
+			else {
+				field.usage = 0;
+			}
+			field.usageMaximum = field.usage;
+		}
+		table.fields.push_back(field);
+	}
+}
+
+ReportLayout::ReportLayout(const ReportTree& tree) : pimpl(new Impl) {
+	// collect the main items in the order of the descriptor
+	std::vector<const ReportNode*> nodes;
+	std::function<void(const ReportNode&)> collect = [&](const ReportNode& node) {
+		for (const ReportNode::Ptr& child : node.getChildren()) {
+			nodes.push_back(child.get());
+			collect(*child);
+		}
+	};
+	collect(*tree.getRoot());
+
+	// the Report ID byte is present in all reports if any Report ID is declared
+	for (const ReportNode* node : nodes) {
+		if (node->getGlobalState().count(ReportItem::TagsGlobal::REPORT_ID) != 0) {
+			pimpl->m_reportIds = true;
+			break;
+		}
+	}
+	for (const ReportNode* node : nodes) {
+		pimpl->addItem(*node);
+	}
+	for (ReportTable& table : pimpl->m_tables[0]) {
+		if (! table.fields.empty()) {
+			table.program = DecodeProgram(table.fields);
+		}
+	}
+}
+
+ReportLayout::ReportLayout(const ReportLayout& other) : pimpl(new Impl(*other.pimpl)) {
+
+}
+
+ReportLayout::ReportLayout(ReportLayout&& other) noexcept : pimpl(std::move(other.pimpl)) {
+
+}
+
+ReportLayout::~ReportLayout() {
+
+}
+
+ReportLayout& ReportLayout::operator=(const ReportLayout& other) {
+	if (this != &other) {
+		ReportLayout tmp(other);
+		std::swap(pimpl, tmp.pimpl);
+	}
+
+	return *this;
+}
+
+ReportLayout& ReportLayout::operator=(ReportLayout&& other) noexcept {
+	if (this != &other) {
+		pimpl = std::move(other.pimpl);
+	}
+
+	return *this;
+}
+
+bool ReportLayout::usesReportIds() const {
+	return pimpl->m_reportIds;
+}
+
+const std::vector<ReportField>& ReportLayout::getFields(std::uint8_t reportId, ReportItem::TagsMain type) const {
+	static const std::vector<ReportField> empty;
+	std::size_t index(typeIndex(type));
+	return index != ReportTypes ? pimpl->m_tables[index][reportId].fields : empty;
+}
+
+std::size_t ReportLayout::getReportLength(std::uint8_t reportId, ReportItem::TagsMain type) const {
+	std::size_t index(typeIndex(type));
+	return index != ReportTypes ? (pimpl->m_tables[index][reportId].bitLength + 7) / 8 : 0;
+}
+
+std::uint8_t ReportLayout::decode(ByteBufferView report, std::vector<std::int32_t>& values) const {
+	std::uint8_t reportId(0);
+	if (pimpl->m_reportIds && ! report.empty()) {
+		reportId = report[0];
+	}
+	const ReportTable& table(pimpl->m_tables[0][reportId]);
+	values.resize(table.fields.size());
+	if (values.empty()) {
+		return reportId;
+	}
+
+	const std::uint8_t* data(report.data());
+	std::size_t readLength(table.program.getReadLength());
+	if (report.size() < readLength) {
+		// a short report, pad the missing fields with zeroes
+		thread_local ByteBuffer padded;
+		padded.resize(readLength);
+		std::memcpy(padded.data(), report.data(), report.size());
+		std::memset(padded.data() + report.size(), 0, readLength - report.size());
+		data = padded.data();
+	}
+	table.program.run(data, values.data());
+	return reportId;
+}
+
+bool ReportLayout::isVectorized() {
+	return DecodeProgram::isVectorized();
+}
+
+std::int32_t ReportLayout::extract(ByteBufferView report, const ReportField& field) {
+	// load 8 bytes containing the field at once, the field spans at most 5 of them
+	std::size_t byte(field.bitOffset / 8);
+	std::uint64_t raw(0);
+	if (byte + sizeof(raw) <= report.size()) {
+		std::memcpy(&raw, report.data() + byte, sizeof(raw));
+	}
+	else if (byte < report.size()) {
+		std::memcpy(&raw, report.data() + byte, report.size() - byte);
+	}
+	if (WireFormat::Detail::HostEndian != WireFormat::Endian::LITTLE) {
+		raw = WireFormat::Detail::byteSwap(raw);
+	}
+
+	std::uint32_t value(static_cast<std::uint32_t>(raw >> (field.bitOffset % 8)));
+	if (field.bitSize < 32) {
+		value &= (std::uint32_t(1) << field.bitSize) - 1;
+		if (field.isSigned) {
+			// move the sign bit to the top and shift back
+			return static_cast<std::int32_t>(value << (32 - field.bitSize)) >> (32 - field.bitSize);
+		}
+	}
+	return static_cast<std::int32_t>(value);
+}
+
+}
+}
@@ -17,6 +17,7 @@
 
 #include "hidreport.h"
 
+#include <algorithm>
 #include <stack>
 #include <utility>
 
@@ -30,10 +31,11 @@ public:
 	Type m_type; // bType
 	std::uint8_t m_tag; // bTag/bLongItemTag
 	std::size_t m_bytelen; // length of the binary representation in bytes
-	ByteBuffer m_data;
+	std::shared_ptr<const ByteBuffer> m_descriptor; // keeps m_data valid
+	ByteBufferView m_data;
 
 	Impl();
-	explicit Impl(const std::uint8_t* data_);
+	Impl(const std::shared_ptr<const ByteBuffer>& descriptor_, std::size_t offset);
 	Impl(const Impl& other);
 	~Impl();
 };
@@ -53,11 +55,14 @@ ReportItem::Impl::Impl(const Impl& other) :
 	m_type(other.m_type),
 	m_tag(other.m_tag),
 	m_bytelen(other.m_bytelen),
+	m_descriptor(other.m_descriptor),
 	m_data(other.m_data) {
 
 }
 
-ReportItem::Impl::Impl(const std::uint8_t* data_) {
+ReportItem::Impl::Impl(const std::shared_ptr<const ByteBuffer>& descriptor_, std::size_t offset) :
+	m_descriptor(descriptor_) {
+	const std::uint8_t* data_(descriptor_->data() + offset);
 	std::uint8_t bSize = data_[0] & 0x3;
 	std::uint8_t bType = (data_[0] >> 2) & 0x3;
 	std::uint8_t bTag = (data_[0] >> 4) & 0xf;
@@ -72,7 +77,7 @@ ReportItem::Impl::Impl(const std::uint8_t* data_) {
 		m_type = static_cast<Type>(bType);
 		m_tag = data_[2];
 		if (m_dataSize > 0) {
-			m_data = ByteBuffer(&data_[3], m_dataSize);
+			m_data = ByteBufferView(&data_[3], m_dataSize);
 		}
 		/* move the iterator to the next item */
 		m_bytelen = m_dataSize + 3;
@@ -84,7 +89,7 @@ ReportItem::Impl::Impl(const std::uint8_t* data_) {
 		m_type = static_cast<Type>(bType);
 		m_tag = bTag;
 		if (m_dataSize > 0) {
-			m_data = ByteBuffer(&data_[1], m_dataSize);
+			m_data = ByteBufferView(&data_[1], m_dataSize);
 		}
 		/* move the iterator to the next item */
 		m_bytelen = m_dataSize + 1;
@@ -100,6 +105,7 @@ public:
 	// state
 	GlobalItemMap m_globalState;
 	LocalItemMap m_localState;
+	std::vector<ReportItem> m_usages;
 	// the actual item with data
 	const ReportItem m_item;
 	// structural members
@@ -111,7 +117,8 @@ public:
 	Impl(const Ptr& parent_,
 	     const ReportItem& item_,
 	     const GlobalItemMap& globalState_,
-	     const LocalItemMap& localState_);
+	     const LocalItemMap& localState_,
+	     const std::vector<ReportItem>& usages_);
 };
 
 ReportNode::Impl::Impl() {
@@ -121,6 +128,7 @@ ReportNode::Impl::Impl() {
 ReportNode::Impl::Impl(const Impl& other) :
 	m_globalState(other.m_globalState),
 	m_localState(other.m_localState),
+	m_usages(other.m_usages),
 	m_item(other.m_item),
 	m_parent(other.m_parent),
 	m_children(other.m_children) {
@@ -130,9 +138,11 @@ ReportNode::Impl::Impl(const Impl& other) :
 ReportNode::Impl::Impl(const Ptr& parent_,
                        const ReportItem& item_,
                        const GlobalItemMap& globalState_,
-                       const LocalItemMap& localState_) :
+                       const LocalItemMap& localState_,
+                       const std::vector<ReportItem>& usages_) :
 	m_globalState(globalState_),
 	m_localState(localState_),
+	m_usages(usages_),
 	m_item(item_),
 	m_parent(parent_) {
 
@@ -154,7 +164,8 @@ ReportItem::~ReportItem() {
 
 }
 
-ReportItem::ReportItem(const std::uint8_t* data) : pimpl(new Impl(data)) {
+ReportItem::ReportItem(const std::shared_ptr<const ByteBuffer>& descriptor, std::size_t offset) :
+	pimpl(new Impl(descriptor, offset)) {
 
 }
 
@@ -191,10 +202,29 @@ std::uint8_t ReportItem::getTag() const {
 	return pimpl->m_tag;
 }
 
-const ByteBuffer& ReportItem::getData() const {
+ByteBufferView ReportItem::getData() const {
 	return pimpl->m_data;
 }
 
+std::uint32_t ReportItem::getUnsigned() const {
+	const ByteBufferView& data_(pimpl->m_data);
+	std::uint32_t value(0);
+	for (std::size_t i = 0; i < data_.size() && i < 4; i++) {
+		value |= static_cast<std::uint32_t>(data_[i]) << (8 * i);
+	}
+	return value;
+}
+
+std::int32_t ReportItem::getSigned() const {
+	std::size_t size(std::min<std::size_t>(pimpl->m_data.size(), 4));
+	if (size == 0) {
+		return 0;
+	}
+	// move the sign bit to the top and shift back
+	std::uint32_t value(getUnsigned() << (32 - 8 * size));
+	return static_cast<std::int32_t>(value) >> (32 - 8 * size);
+}
+
 ReportNode::ReportNode() : pimpl(new Impl) {
 
 }
@@ -202,8 +232,9 @@ ReportNode::ReportNode() : pimpl(new Impl) {
 ReportNode::ReportNode(const Ptr& parent_,
                        const ReportItem& item_,
                        const GlobalItemMap& globalState_,
-                       const LocalItemMap& localState_) :
-	pimpl(new Impl(parent_, item_, globalState_, localState_)) {
+                       const LocalItemMap& localState_,
+                       const std::vector<ReportItem>& usages_) :
+	pimpl(new Impl(parent_, item_, globalState_, localState_, usages_)) {
 
 }
 
@@ -243,6 +274,10 @@ const ReportNode::GlobalItemMap& ReportNode::getGlobalState() const {
 const ReportNode::LocalItemMap& ReportNode::getLocalState() const {
 	return pimpl->m_localState;
 }
+const std::vector<ReportItem>& ReportNode::getUsages() const {
+	return pimpl->m_usages;
+}
+
 const ReportItem& ReportNode::getItem() const {
 	return pimpl->m_item;
 }
@@ -262,37 +297,41 @@ ReportTree::ReportTree(const ByteBuffer& buffer) :
 	GlobalItemTableStack globalItemTableStack;
 	ReportNode::GlobalItemMap globalState;
 	ReportNode::LocalItemMap localState;
+	std::vector<ReportItem> usages;
 
 	ReportNode::Ptr lastroot = m_root;
 
+	// a single copy of the descriptor is shared by the data of all the items
+	std::shared_ptr<const ByteBuffer> descriptor(std::make_shared<ByteBuffer>(buffer));
 	for (std::size_t i = 0; i < buffer.size();) {
 		// load the item
-		ReportItem item(&(buffer.data()[i]));
+		ReportItem item(descriptor, i);
 		i += item.pimpl->m_bytelen;
 
 		switch (item.getType()) {
 			case ReportItem::Type::MAIN: {
 				switch (static_cast<ReportItem::TagsMain>(item.getTag())) {
 					case ReportItem::TagsMain::COLLECTION: {
-						ReportNode::Ptr newnode(new ReportNode(lastroot, item, globalState, localState));
+						ReportNode::Ptr newnode(new ReportNode(lastroot, item, globalState, localState, usages));
 						lastroot->pimpl->m_children.push_back(newnode);
 						lastroot = newnode;
 						break;
 					}
 					case ReportItem::TagsMain::END_COLLECTION: {
-						ReportNode::Ptr newnode(new ReportNode(lastroot, item, globalState, localState));
+						ReportNode::Ptr newnode(new ReportNode(lastroot, item, globalState, localState, usages));
 						lastroot->pimpl->m_children.push_back(newnode);
 						lastroot = lastroot->pimpl->m_parent;
 						break;
 					}
 					default: {
-						ReportNode::Ptr newnode(new ReportNode(lastroot, item, globalState, localState));
+						ReportNode::Ptr newnode(new ReportNode(lastroot, item, globalState, localState, usages));
 						lastroot->pimpl->m_children.push_back(newnode);
 						break;
 					}
 				}
 				// reset the local state
 				localState.clear();
+				usages.clear();
 				break;
 			}
 			case ReportItem::Type::GLOBAL: {
@@ -317,6 +356,9 @@ ReportTree::ReportTree(const ByteBuffer& buffer) :
 			}
 			case ReportItem::Type::LOCAL: {
 				localState[static_cast<ReportItem::TagsLocal>(item.getTag())] = item;
+				if (static_cast<ReportItem::TagsLocal>(item.getTag()) == ReportItem::TagsLocal::USAGE) {
+					usages.push_back(item);
+				}
 				break;
 			}
 			default:
@@ -0,0 +1,154 @@
+/*
+ * This file is part of Usbpp, a C++ wrapper around libusb
+ * Copyright (C) 2016  Lukas Jirkovsky <l.jirkovsky @at@ gmail.com>
+ *
+ * Usbpp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, version 3 of the License
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "interruptpoller.h"
+
+#include <algorithm>
+#include <cassert>
+
+#include "deviceimpl.h"
+#include "transferpipeline.h"
+
+namespace {
+
+// the number of failed transfers in a row after which the polling gives up
+const unsigned int MaxConsecutiveErrors = 8;
+
+}
+
+namespace Usbpp {
+
+class InterruptPoller::Impl {
+public:
+	Impl(const Device& device, unsigned char endpoint, std::size_t reportSize, unsigned int transfers);
+
+	/**
+	 * Turn a finished transfer into a report
+	 */
+	bool handleTransfer(libusb_transfer* transfer);
+	/**
+	 * Copy a report into the sink
+	 */
+	void storeReport(const InterruptReport& report);
+
+	// keeps the device handle open
+	Device m_device;
+	ReportCallback m_callback;
+	StreamSink* m_sink;
+	// the completions are serialized by the libusb event handling
+	std::uint64_t m_sequence;
+	unsigned int m_consecutiveErrors;
+	TransferPipeline m_pipeline;
+};
+
+InterruptPoller::Impl::Impl(const Device& device, unsigned char endpoint, std::size_t reportSize, unsigned int transfers) :
+	m_device(device),
+	m_sink(nullptr),
+	m_sequence(0),
+	m_consecutiveErrors(0),
+	m_pipeline(device.pimpl->m_handle, LIBUSB_TRANSFER_TYPE_INTERRUPT, endpoint, reportSize, transfers, 0,
+	           [this](libusb_transfer* transfer) {
+		return handleTransfer(transfer);
+	}) {
+
+}
+
+void InterruptPoller::Impl::storeReport(const InterruptReport& report) {
+	if (report.error != 0) {
+		return;
+	}
+	std::size_t size(report.length);
+	std::uint8_t* buffer(m_sink->claim(size));
+	if (buffer == nullptr) {
+		m_sink->drop(report.length);
+		return;
+	}
+	std::size_t length(std::min(static_cast<std::size_t>(report.length), size));
+	std::copy(report.data, report.data + length, buffer);
+	m_sink->commit(length);
+}
+
+bool InterruptPoller::Impl::handleTransfer(libusb_transfer* transfer) {
+	InterruptReport report;
+	report.sequence = m_sequence++;
+	report.timestamp = std::chrono::steady_clock::now();
+	report.error = getTransferError(transfer->status);
+	report.data = transfer->buffer;
+	report.length = transfer->actual_length;
+
+	if (transfer->status == LIBUSB_TRANSFER_CANCELLED) {
+		return false;
+	}
+	m_callback(report);
+
+	switch (transfer->status) {
+		case LIBUSB_TRANSFER_COMPLETED:
+			m_consecutiveErrors = 0;
+			return true;
+		case LIBUSB_TRANSFER_NO_DEVICE:
+		case LIBUSB_TRANSFER_STALL:
+			// the halt can be cleared only synchronously, leave it to the user
+			return false;
+		default:
+			// don't spin on an endpoint that keeps failing
+			return ++m_consecutiveErrors < MaxConsecutiveErrors;
+	}
+}
+
+InterruptPoller::InterruptPoller(const Device& device, unsigned char endpoint, std::size_t reportSize, unsigned int transfers) :
+	pimpl(new Impl(device, endpoint, reportSize, std::max(transfers, 1u))) {
+
+	assert(endpoint & LIBUSB_ENDPOINT_IN);
+}
+
+InterruptPoller::~InterruptPoller() {
+	stop();
+}
+
+void InterruptPoller::start(const ReportCallback& callback) {
+	if (isRunning()) {
+		return;
+	}
+	pimpl->m_callback = callback;
+	pimpl->m_sink = nullptr;
+	pimpl->m_sequence = 0;
+	pimpl->m_consecutiveErrors = 0;
+	pimpl->m_pipeline.start();
+}
+
+void InterruptPoller::start(StreamSink& sink) {
+	if (isRunning()) {
+		return;
+	}
+	pimpl->m_sink = &sink;
+	pimpl->m_callback = [this](const InterruptReport& report) {
+		pimpl->storeReport(report);
+	};
+	pimpl->m_sequence = 0;
+	pimpl->m_consecutiveErrors = 0;
+	pimpl->m_pipeline.start();
+}
+
+void InterruptPoller::stop() {
+	pimpl->m_pipeline.stop();
+}
+
+bool InterruptPoller::isRunning() const {
+	return pimpl->m_pipeline.getInFlight() != 0;
+}
+
+}
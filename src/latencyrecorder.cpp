@@ -0,0 +1,87 @@
+/*
+ * This file is part of Usbpp, a C++ wrapper around libusb
+ * Copyright (C) 2016  Lukas Jirkovsky <l.jirkovsky @at@ gmail.com>
+ *
+ * Usbpp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, version 3 of the License
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "latencyrecorder.h"
+
+#include <limits>
+
+namespace {
+thread_local Usbpp::LatencyRecorder* currentRecorder = nullptr;
+}
+
+namespace Usbpp {
+
+LatencyRecorder::LatencyRecorder() {
+	reset();
+}
+
+void LatencyRecorder::beginPoll() {
+	m_pollStart = std::chrono::steady_clock::now();
+	m_polls.store(m_polls.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+void LatencyRecorder::record() {
+	std::int64_t latency(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - m_pollStart).count());
+	// there is a single writer, no need for read-modify-write operations
+	m_completions.store(m_completions.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	m_sum.store(m_sum.load(std::memory_order_relaxed) + latency, std::memory_order_relaxed);
+	if (latency < m_min.load(std::memory_order_relaxed)) {
+		m_min.store(latency, std::memory_order_relaxed);
+	}
+	if (latency > m_max.load(std::memory_order_relaxed)) {
+		m_max.store(latency, std::memory_order_relaxed);
+	}
+}
+
+void LatencyRecorder::reset() {
+	m_polls = 0;
+	m_completions = 0;
+	m_sum = 0;
+	m_min = std::numeric_limits<std::int64_t>::max();
+	m_max = 0;
+}
+
+std::uint64_t LatencyRecorder::getPolls() const {
+	return m_polls;
+}
+
+std::uint64_t LatencyRecorder::getCompletions() const {
+	return m_completions;
+}
+
+std::chrono::nanoseconds LatencyRecorder::getMin() const {
+	return std::chrono::nanoseconds(m_completions != 0 ? m_min.load() : 0);
+}
+
+std::chrono::nanoseconds LatencyRecorder::getMean() const {
+	std::uint64_t completions(m_completions);
+	return std::chrono::nanoseconds(completions != 0 ? m_sum / static_cast<std::int64_t>(completions) : 0);
+}
+
+std::chrono::nanoseconds LatencyRecorder::getMax() const {
+	return std::chrono::nanoseconds(m_max);
+}
+
+LatencyRecorder* LatencyRecorder::current() {
+	return currentRecorder;
+}
+
+void LatencyRecorder::setCurrent(LatencyRecorder* recorder) {
+	currentRecorder = recorder;
+}
+
+}
@@ -0,0 +1,79 @@
+/*
+ * This file is part of Usbpp, a C++ wrapper around libusb
+ * Copyright (C) 2016  Lukas Jirkovsky <l.jirkovsky @at@ gmail.com>
+ *
+ * Usbpp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, version 3 of the License
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBUSBPP_LATENCYRECORDER_H_
+#define LIBUSBPP_LATENCYRECORDER_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+namespace Usbpp {
+
+/**
+ * Measures the latency between the completion of a transfer and its callback.
+ *
+ * The event loop marks the beginning of every poll of the libusb events,
+ * the transfer callbacks record the time elapsed since then. The recorder
+ * is updated by a single thread, but it can be read from any thread.
+ */
+class LatencyRecorder {
+public:
+	LatencyRecorder();
+
+	/**
+	 * Mark the beginning of a poll.
+	 */
+	void beginPoll();
+	/**
+	 * Record a callback of a transfer completed in the current poll.
+	 */
+	void record();
+	/**
+	 * Reset all statistics.
+	 */
+	void reset();
+
+	std::uint64_t getPolls() const;
+	std::uint64_t getCompletions() const;
+	std::chrono::nanoseconds getMin() const;
+	std::chrono::nanoseconds getMean() const;
+	std::chrono::nanoseconds getMax() const;
+
+	/**
+	 * Get the recorder of the event loop running in the current thread.
+	 *
+	 * \return the recorder or nullptr if the latency is not measured.
+	 */
+	static LatencyRecorder* current();
+	/**
+	 * Set the recorder of the event loop running in the current thread.
+	 */
+	static void setCurrent(LatencyRecorder* recorder);
+
+private:
+	std::chrono::steady_clock::time_point m_pollStart;
+	std::atomic<std::uint64_t> m_polls;
+	std::atomic<std::uint64_t> m_completions;
+	std::atomic<std::int64_t> m_sum;
+	std::atomic<std::int64_t> m_min;
+	std::atomic<std::int64_t> m_max;
+};
+
+}
+
+#endif
@@ -20,8 +20,22 @@
 #include <cassert>
 #include <cstring>
 
+#include "wireformat.h"
+
 namespace {
-constexpr std::size_t CBW_LEN = 31;
+// layout of the CBW
+namespace Cbw {
+typedef Usbpp::WireFormat::Field<0, uint32_t> Signature;
+typedef Usbpp::WireFormat::Field<4, uint32_t> Tag;
+typedef Usbpp::WireFormat::Field<8, uint32_t> DataTransferLength;
+typedef Usbpp::WireFormat::Field<12, uint8_t> Flags;
+typedef Usbpp::WireFormat::Field<13, uint8_t> Lun;
+typedef Usbpp::WireFormat::Field<14, uint8_t> CommandBlockLength;
+typedef Usbpp::WireFormat::Bytes<15, 16> CommandBlock;
+}
+
+constexpr std::size_t CBW_LEN = Cbw::CommandBlock::end;
+constexpr uint32_t CBW_SIGNATURE = 0x43425355; // "USBC"
 }
 
 namespace Usbpp {
@@ -47,37 +61,19 @@ CommandBlockWrapper::CommandBlockWrapper(uint32_t dCBWDataTransferLength,
                                          uint8_t bCBWLUN,
                                          std::vector<uint8_t> CBWCB) :
 	m_data(CBW_LEN) {
-	// only CBWCB needs to be zeroed as the rest will be written into
-	std::memset(&m_data[15], 0, CBW_LEN - 15);
-
-	// dCBWSignature
-	m_data[0] = 'U';
-	m_data[1] = 'S';
-	m_data[2] = 'B';
-	m_data[3] = 'C';
-	// dCBWTag
-	uint32_t tag(generateTag());
-	m_data[4] = tag & 0xFF;
-	m_data[5] = (tag >> 8) & 0xFF;
-	m_data[6] = (tag >> 16) & 0xFF;
-	m_data[7] = (tag >> 24) & 0xFF;
-	// dCBWDataTransferLength
-	m_data[8] = dCBWDataTransferLength & 0xFF;
-	m_data[9] = (dCBWDataTransferLength >> 8) & 0xFF;
-	m_data[10] = (dCBWDataTransferLength >> 16) & 0xFF;
-	m_data[11] = (dCBWDataTransferLength >> 24) & 0xFF;
-	// bmCBWFlags
+	uint8_t* data(m_data.data());
+	Cbw::Signature::store(data, CBW_SIGNATURE);
+	Cbw::Tag::store(data, generateTag());
+	Cbw::DataTransferLength::store(data, dCBWDataTransferLength);
 	assert((bmCBWFlags & 0x3F) ==  0); // reserved bits
 	assert((bmCBWFlags & 0x40) ==  0); // obsolete bits
-	m_data[12] = bmCBWFlags;
-	// bCBWLUN
+	Cbw::Flags::store(data, bmCBWFlags);
 	assert((bCBWLUN & 0xF) ==  bCBWLUN);
-	m_data[13] = bCBWLUN;
-	// bCBWCBLength
-	assert((CBWCB.size() & 0x1F) ==  CBWCB.size());
-	m_data[14] = CBWCB.size() & 0x1F;
-	// CBWCB
-	std::memcpy(&m_data[15], &CBWCB[0], CBWCB.size());
+	Cbw::Lun::store(data, bCBWLUN);
+	assert(CBWCB.size() <= Cbw::CommandBlock::size);
+	Cbw::CommandBlockLength::store(data, CBWCB.size() & 0x1F);
+	// also zeroes the unused part of CBWCB
+	Cbw::CommandBlock::store(data, ByteBufferView(CBWCB.data(), CBWCB.size()));
 }
 
 CommandBlockWrapper::~CommandBlockWrapper() {
@@ -110,40 +106,31 @@ CommandBlockWrapper& CommandBlockWrapper::operator=(CommandBlockWrapper&& other)
 }
 
 uint32_t CommandBlockWrapper::getTag() const {
-	uint32_t tag;
-	tag = m_data[7];
-	tag = (tag << 8) | m_data[6];
-	tag = (tag << 8) | m_data[5];
-	tag = (tag << 8) | m_data[4];
-	return tag;
+	return Cbw::Tag::load(m_data.data());
 }
 
 uint32_t CommandBlockWrapper::getTransferLength() const {
-	uint32_t len;
-	len = m_data[11];
-	len = (len << 8) | m_data[10];
-	len = (len << 8) | m_data[9];
-	len = (len << 8) | m_data[8];
-	return len;
+	return Cbw::DataTransferLength::load(m_data.data());
 }
 
 CommandBlockWrapper::Flags CommandBlockWrapper::getFlags() const {
-	if ((m_data[12] & static_cast<uint8_t>(Flags::INVALID)) != 0) {
+	uint8_t flags(Cbw::Flags::load(m_data.data()));
+	if ((flags & static_cast<uint8_t>(Flags::INVALID)) != 0) {
 		return Flags::INVALID;
 	}
-	return static_cast<Flags>(m_data[12]);
+	return static_cast<Flags>(flags);
 }
 
 uint8_t CommandBlockWrapper::getLun() const {
-	return m_data[13];
+	return Cbw::Lun::load(m_data.data());
 }
 
 uint8_t CommandBlockWrapper::getCommandBlockLength() const {
-	return m_data[14];
+	return Cbw::CommandBlockLength::load(m_data.data());
 }
 
-std::vector< uint8_t > CommandBlockWrapper::getCommandBlock() const {
-	return std::vector<uint8_t>(&m_data[15], &m_data[15] + getCommandBlockLength());
+ByteBufferView CommandBlockWrapper::getCommandBlock() const {
+	return Cbw::CommandBlock::view(m_data.data(), getCommandBlockLength());
 }
 
 const ByteBuffer& CommandBlockWrapper::getBuffer() const {
@@ -22,8 +22,19 @@
 #include <cassert>
 #include <cstring>
 
+#include "wireformat.h"
+
 namespace {
-constexpr std::size_t CSW_LEN = 13;
+// layout of the CSW
+namespace Csw {
+typedef Usbpp::WireFormat::Field<0, uint32_t> Signature;
+typedef Usbpp::WireFormat::Field<4, uint32_t> Tag;
+typedef Usbpp::WireFormat::Field<8, uint32_t> DataResidue;
+typedef Usbpp::WireFormat::Field<12, uint8_t> Status;
+}
+
+constexpr std::size_t CSW_LEN = Csw::Status::end;
+constexpr uint32_t CSW_SIGNATURE = 0x53425355; // "USBS"
 }
 
 namespace Usbpp {
@@ -40,27 +51,13 @@ CommandStatusWrapper::CommandStatusWrapper(const ByteBuffer& buffer) {
 }
 
 CommandStatusWrapper::CommandStatusWrapper(uint32_t dCSWTag, uint32_t dCSWDataResidue, uint8_t bCSWStatus) : m_data(CSW_LEN) {
-	std::memset(&m_data[0], 0, CSW_LEN);
-
-	// dCSWSignature
-	m_data[0] = 'U';
-	m_data[1] = 'S';
-	m_data[2] = 'B';
-	m_data[3] = 'S';
-	// dCSWTag
-	m_data[4] = (dCSWTag >> 24) & 0xFF;
-	m_data[5] = (dCSWTag >> 16) & 0xFF;
-	m_data[6] = (dCSWTag >> 8) & 0xFF;
-	m_data[7] = dCSWTag & 0xFF;
-	// dCSWDataResidue
-	m_data[8] = (dCSWDataResidue >> 24) & 0xFF;
-	m_data[9] = (dCSWDataResidue >> 16) & 0xFF;
-	m_data[10] = (dCSWDataResidue >> 8) & 0xFF;
-	m_data[11] = dCSWDataResidue & 0xFF;
-	// bCSWStatus
+	uint8_t* data(m_data.data());
+	Csw::Signature::store(data, CSW_SIGNATURE);
+	Csw::Tag::store(data, dCSWTag);
+	Csw::DataResidue::store(data, dCSWDataResidue);
 	assert(bCSWStatus != 0x03 && bCSWStatus != 0x04); // obsolete
 	assert(bCSWStatus < 0x05); // reserved
-	m_data[12] = bCSWStatus;
+	Csw::Status::store(data, bCSWStatus);
 }
 
 CommandStatusWrapper::~CommandStatusWrapper() {
@@ -92,31 +89,22 @@ CommandStatusWrapper& CommandStatusWrapper::operator=(CommandStatusWrapper&& oth
 }
 
 uint32_t CommandStatusWrapper::getTag() const {
-	uint32_t tag;
-	tag = m_data[4];
-	tag = (tag << 8) | m_data[5];
-	tag = (tag << 8) | m_data[6];
-	tag = (tag << 8) | m_data[7];
-	return tag;
+	return Csw::Tag::load(m_data.data());
 }
 
 uint32_t CommandStatusWrapper::getDataResidue() const {
-	uint32_t residue;
-	residue = m_data[8];
-	residue = (residue << 8) | m_data[9];
-	residue = (residue << 8) | m_data[10];
-	residue = (residue << 8) | m_data[11];
-	return residue;
+	return Csw::DataResidue::load(m_data.data());
 }
 
 CommandStatusWrapper::Status CommandStatusWrapper::getStatus() const {
-	if (m_data[12] > 0x05) {
+	uint8_t status(Csw::Status::load(m_data.data()));
+	if (status > 0x05) {
 		return Status::RESERVED;
 	}
-	if (m_data[12] >= 0x03) {
+	if (status >= 0x03) {
 		return Status::OBSOLETE;
 	}
-	return static_cast<Status>(m_data[12]);
+	return static_cast<Status>(status);
 }
 
 const ByteBuffer& CommandStatusWrapper::getBuffer() const {
@@ -168,6 +168,36 @@ CommandStatusWrapper MSDevice::sendCommand(unsigned char endpoint, const Command
 	}
 }
 
+#ifdef USBPP_COROUTINES
+Task<CommandStatusWrapper> MSDevice::sendCommandAsync(unsigned char endpoint, CommandBlockWrapper command, ByteBuffer* data) {
+	// an "in" endpoint derived from the endpoint
+	unsigned char inEndpoint(endpoint | LIBUSB_ENDPOINT_IN);
+
+	// send command
+	co_await bulkOut(endpoint, command.getBuffer(), 2000);
+
+	// if the command is an outgoing command that expects a response, read it
+	if ((endpoint & LIBUSB_ENDPOINT_IN) == 0 && command.getTransferLength() != 0) {
+		ByteBuffer tmpBuf(command.getTransferLength());
+		int transferred = co_await bulkIn(inEndpoint, tmpBuf, 2000);
+		if (data != nullptr) {
+			tmpBuf.resize(transferred);
+			*data = std::move(tmpBuf);
+		}
+	}
+
+	// read status
+	ByteBuffer tmpBuf(13);
+	int transferred = co_await bulkIn(inEndpoint, tmpBuf, 2000);
+	if (transferred == 13) {
+		co_return CommandStatusWrapper(std::move(tmpBuf));
+	}
+	else {
+		throw SCSICommandStatusException();
+	}
+}
+#endif
+
 SCSI::InquiryResponse MSDevice::sendInquiry(unsigned char endpoint, uint8_t LUN) const {
 	return ::sendInquiry(this, endpoint, LUN, false);
 }
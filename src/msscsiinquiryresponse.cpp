@@ -125,34 +125,34 @@ bool InquiryResponse::getCMDQUE() const {
 	return (m_buffer.data()[7] & 0x2) != 0;
 }
 
-ByteBuffer InquiryResponse::getVendorIdentification() const {
-	return ByteBuffer(m_buffer.data() + 8, 8);
+ByteBufferView InquiryResponse::getVendorIdentification() const {
+	return ByteBufferView(m_buffer.data() + 8, 8);
 }
 
-ByteBuffer InquiryResponse::getProductIdentification() const {
-	return ByteBuffer(m_buffer.data() + 16, 16);
+ByteBufferView InquiryResponse::getProductIdentification() const {
+	return ByteBufferView(m_buffer.data() + 16, 16);
 }
 
-ByteBuffer InquiryResponse::getProductRevisionLevel() const {
-	return ByteBuffer(m_buffer.data() +  32, 4);
+ByteBufferView InquiryResponse::getProductRevisionLevel() const {
+	return ByteBufferView(m_buffer.data() + 32, 4);
 }
 
 /********************************
  * fields that may not be present
  *******************************/
 
-ByteBuffer InquiryResponse::getDriverSerialNumber() const {
+ByteBufferView InquiryResponse::getDriverSerialNumber() const {
 	if (m_buffer.size() >= 44) {
-		return ByteBuffer(m_buffer.data() + 36, 8);
+		return ByteBufferView(m_buffer.data() + 36, 8);
 	}
-	return ByteBuffer();
+	return ByteBufferView();
 }
 
-ByteBuffer InquiryResponse::getVendorUnique() const {
+ByteBufferView InquiryResponse::getVendorUnique() const {
 	if (m_buffer.size() >= 56) {
-		return ByteBuffer(m_buffer.data() + 44, 12);
+		return ByteBufferView(m_buffer.data() + 44, 12);
 	}
-	return ByteBuffer();
+	return ByteBufferView();
 }
 
 uint8_t InquiryResponse::getClocking() const {
@@ -179,18 +179,18 @@ bool InquiryResponse::getIUS() const {
 	return 0;
 }
 
-ByteBuffer InquiryResponse::getVersionDescriptor(unsigned int descriptor) const {
+ByteBufferView InquiryResponse::getVersionDescriptor(unsigned int descriptor) const {
 	if (m_buffer.size() >= 60 + 2*descriptor) {
-		return ByteBuffer(m_buffer.data() + 58 + 2*descriptor, 2);
+		return ByteBufferView(m_buffer.data() + 58 + 2*descriptor, 2);
 	}
-	return ByteBuffer();
+	return ByteBufferView();
 }
 
-ByteBuffer InquiryResponse::getVendorSpecific() const {
+ByteBufferView InquiryResponse::getVendorSpecific() const {
 	if (m_buffer.size() >= 97) {
-		return ByteBuffer(m_buffer.data() + 96, m_buffer.size() - 96);
+		return ByteBufferView(m_buffer.data() + 96, m_buffer.size() - 96);
 	}
-	return ByteBuffer();
+	return ByteBufferView();
 }
 
 }
@@ -0,0 +1,317 @@
+/*
+ * This file is part of Usbpp, a C++ wrapper around libusb
+ * Copyright (C) 2016  Lukas Jirkovsky <l.jirkovsky @at@ gmail.com>
+ *
+ * Usbpp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, version 3 of the License
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "probe.h"
+
+#include "context.h"
+#include "msdevice.h"
+#include "msscsiinquiryresponse.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <mutex>
+#include <thread>
+
+#include <libusb.h>
+
+#include "deviceimpl.h"
+
+namespace {
+
+using namespace Usbpp;
+
+using Clock = std::chrono::steady_clock;
+
+/**
+ * Probing of a single device.
+ */
+class Prober {
+public:
+	Prober(const Device& device, libusb_device* usbdevice, const ProbeOptions& options);
+
+	ProbeResult run();
+
+private:
+	/**
+	 * Get the time remaining to the deadline in milliseconds.
+	 *
+	 * Marks the result as timed out if there is no time left.
+	 */
+	unsigned int remaining();
+	/**
+	 * Record an error, only the first error is kept.
+	 */
+	void setError(int error);
+
+	std::string readString(uint8_t index);
+	void probeInterfaces();
+
+	libusb_device* m_usbdevice;
+	const ProbeOptions& m_options;
+	Clock::time_point m_deadline;
+	ProbeResult m_result;
+	uint16_t m_langid;
+};
+
+Prober::Prober(const Device& device, libusb_device* usbdevice, const ProbeOptions& options) :
+	m_usbdevice(usbdevice),
+	m_options(options),
+	m_deadline(Clock::now() + std::chrono::milliseconds(options.timeout)),
+	m_langid(0) {
+
+	m_result.device = device;
+}
+
+ProbeResult Prober::run() {
+	Device& device(m_result.device);
+
+	libusb_device_descriptor desc(device.getDescriptor());
+	m_result.vendorId = desc.idVendor;
+	m_result.productId = desc.idProduct;
+	m_result.deviceClass = desc.bDeviceClass;
+
+	if (m_options.steps == 0) {
+		return m_result;
+	}
+
+	try {
+		device.open(m_options.detachDriver);
+	}
+	catch (const Exception& e) {
+		setError(e.getError());
+		return m_result;
+	}
+
+	if (m_options.steps & ProbeOptions::STRINGS) {
+		m_result.manufacturer = readString(desc.iManufacturer);
+		m_result.product = readString(desc.iProduct);
+		m_result.serialNumber = readString(desc.iSerialNumber);
+	}
+	if (m_options.steps & (ProbeOptions::HID_REPORT | ProbeOptions::SCSI_INQUIRY)) {
+		probeInterfaces();
+	}
+
+	device.close();
+	return std::move(m_result);
+}
+
+unsigned int Prober::remaining() {
+	Clock::duration left(m_deadline - Clock::now());
+	if (left <= Clock::duration::zero()) {
+		m_result.timedOut = true;
+		return 0;
+	}
+	// round up, 0 would mean an unlimited timeout
+	return std::chrono::duration_cast<std::chrono::milliseconds>(left).count() + 1;
+}
+
+void Prober::setError(int error) {
+	if (m_result.error == 0) {
+		m_result.error = error;
+	}
+}
+
+std::string Prober::readString(uint8_t index) {
+	if (index == 0) {
+		return std::string();
+	}
+
+	try {
+		// the first language supported by the device is used
+		if (m_langid == 0) {
+			unsigned int timeout(remaining());
+			if (timeout == 0) {
+				return std::string();
+			}
+			ByteBuffer langids(4);
+			int res(m_result.device.controlTransferIn(LIBUSB_ENDPOINT_IN,
+			                                          LIBUSB_REQUEST_GET_DESCRIPTOR,
+			                                          LIBUSB_DT_STRING << 8, 0,
+			                                          langids, timeout));
+			if (res < 4) {
+				setError(LIBUSB_ERROR_IO);
+				return std::string();
+			}
+			m_langid = langids[2] | (langids[3] << 8);
+		}
+
+		unsigned int timeout(remaining());
+		if (timeout == 0) {
+			return std::string();
+		}
+		ByteBuffer buffer(255);
+		int res(m_result.device.controlTransferIn(LIBUSB_ENDPOINT_IN,
+		                                          LIBUSB_REQUEST_GET_DESCRIPTOR,
+		                                          (LIBUSB_DT_STRING << 8) | index, m_langid,
+		                                          buffer, timeout));
+		if (res < 2 || buffer[1] != LIBUSB_DT_STRING) {
+			setError(LIBUSB_ERROR_IO);
+			return std::string();
+		}
+
+		// convert the UTF-16LE string to ASCII the same way libusb does
+		std::string str;
+		for (int i = 2; i + 1 < std::min<int>(res, buffer[0]); i += 2) {
+			str.push_back(buffer[i + 1] != 0 || (buffer[i] & 0x80) ? '?' : buffer[i]);
+		}
+		return str;
+	}
+	catch (const Exception& e) {
+		setError(e.getError());
+		return std::string();
+	}
+}
+
+void Prober::probeInterfaces() {
+	libusb_config_descriptor* config;
+	int res(libusb_get_active_config_descriptor(m_usbdevice, &config));
+	if (res != 0) {
+		setError(res);
+		return;
+	}
+
+	for (int i = 0; i < config->bNumInterfaces; ++i) {
+		if (config->interface[i].num_altsetting < 1) {
+			continue;
+		}
+		const libusb_interface_descriptor& interface(config->interface[i].altsetting[0]);
+		bool hid((m_options.steps & ProbeOptions::HID_REPORT) &&
+		         interface.bInterfaceClass == LIBUSB_CLASS_HID);
+		// SCSI transparent command set, bulk-only transport
+		bool scsi((m_options.steps & ProbeOptions::SCSI_INQUIRY) &&
+		          interface.bInterfaceClass == LIBUSB_CLASS_MASS_STORAGE &&
+		          interface.bInterfaceSubClass == 0x06 &&
+		          interface.bInterfaceProtocol == 0x50);
+		if (!hid && !scsi) {
+			continue;
+		}
+
+		unsigned int timeout(remaining());
+		if (timeout == 0) {
+			break;
+		}
+
+		if (hid) {
+			// a standard request, no need to claim an interface that may be bound to the kernel driver
+			try {
+				ByteBuffer report(4096);
+				int transferred(m_result.device.controlTransferIn(LIBUSB_ENDPOINT_IN | LIBUSB_RECIPIENT_INTERFACE,
+				                                                  LIBUSB_REQUEST_GET_DESCRIPTOR,
+				                                                  LIBUSB_DT_REPORT << 8,
+				                                                  interface.bInterfaceNumber,
+				                                                  report, timeout));
+				report.resize(transferred);
+				m_result.hidReports.insert(std::make_pair(interface.bInterfaceNumber, std::move(report)));
+			}
+			catch (const Exception& e) {
+				setError(e.getError());
+			}
+			continue;
+		}
+
+		try {
+			m_result.device.claimInterface(interface.bInterfaceNumber);
+			for (int e = 0; e < interface.bNumEndpoints; ++e) {
+				const libusb_endpoint_descriptor& endpoint(interface.endpoint[e]);
+				if ((endpoint.bmAttributes & 0x3) == LIBUSB_TRANSFER_TYPE_BULK &&
+				        (endpoint.bEndpointAddress & LIBUSB_ENDPOINT_IN) == 0) {
+					MassStorage::MSDevice msdevice(m_result.device);
+					m_result.inquiries.insert(std::make_pair(interface.bInterfaceNumber,
+					                                         msdevice.sendInquiry(endpoint.bEndpointAddress, 0)));
+					break;
+				}
+			}
+		}
+		catch (const Exception& e) {
+			setError(e.getError());
+		}
+		m_result.device.releaseInterface(interface.bInterfaceNumber);
+	}
+
+	libusb_free_config_descriptor(config);
+}
+
+}
+
+namespace Usbpp {
+
+ProbeOptions::ProbeOptions() :
+	steps(STRINGS),
+	concurrency(8),
+	timeout(2000),
+	detachDriver(false) {
+
+}
+
+ProbeResult::ProbeResult() :
+	error(0),
+	timedOut(false),
+	vendorId(0),
+	productId(0),
+	deviceClass(0) {
+
+}
+
+std::vector<ProbeResult> Context::probeDevices(const ProbeOptions& options,
+                                               const std::function<void(const ProbeResult&)>& func) {
+	std::vector<Device> devices(getDevices());
+
+	std::vector<ProbeResult> results;
+	results.reserve(devices.size());
+	std::mutex resultsMutex;
+	std::atomic<std::size_t> next(0);
+	// the first exception thrown by func, rethrown once the threads finish
+	std::exception_ptr funcError;
+
+	auto worker = [&]() {
+		for (std::size_t i = next++; i < devices.size(); i = next++) {
+			ProbeResult result(Prober(devices[i], devices[i].pimpl->m_device, options).run());
+
+			std::lock_guard<std::mutex> lock(resultsMutex);
+			if (func && !funcError) {
+				try {
+					func(result);
+				}
+				catch (...) {
+					funcError = std::current_exception();
+					// don't start probing any more devices
+					next = devices.size();
+				}
+			}
+			results.push_back(std::move(result));
+		}
+	};
+
+	std::size_t threadCount(std::min<std::size_t>(std::max(options.concurrency, 1u), devices.size()));
+	std::vector<std::thread> threads;
+	threads.reserve(threadCount);
+	for (std::size_t i = 0; i < threadCount; ++i) {
+		threads.emplace_back(worker);
+	}
+	for (std::thread& thread : threads) {
+		thread.join();
+	}
+	if (funcError) {
+		std::rethrow_exception(funcError);
+	}
+
+	return results;
+}
+
+}
@@ -0,0 +1,134 @@
+/*
+ * This file is part of Usbpp, a C++ wrapper around libusb
+ * Copyright (C) 2016  Lukas Jirkovsky <l.jirkovsky @at@ gmail.com>
+ *
+ * Usbpp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, version 3 of the License
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "sharedbuffer.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace Usbpp {
+
+SharedBuffer::SharedBuffer() : m_data(nullptr), m_size(0) {
+
+}
+
+SharedBuffer::SharedBuffer(ByteBuffer&& buffer) :
+	m_storage(std::make_shared<ByteBuffer>(std::move(buffer))),
+	m_data(m_storage->data()),
+	m_size(m_storage->size()) {
+
+}
+
+SharedBuffer::SharedBuffer(const std::uint8_t* data_, std::size_t size_) :
+	m_storage(std::make_shared<ByteBuffer>(data_, size_)),
+	m_data(m_storage->data()),
+	m_size(m_storage->size()) {
+
+}
+
+SharedBuffer::SharedBuffer(const SharedBuffer& other) :
+	m_storage(other.m_storage),
+	m_data(other.m_data),
+	m_size(other.m_size) {
+
+}
+
+SharedBuffer::SharedBuffer(SharedBuffer&& other) noexcept :
+	m_storage(std::move(other.m_storage)),
+	m_data(other.m_data),
+	m_size(other.m_size) {
+	other.m_data = nullptr;
+	other.m_size = 0;
+}
+
+SharedBuffer::~SharedBuffer() {
+
+}
+
+SharedBuffer& SharedBuffer::operator=(const SharedBuffer& other) {
+	if (this != &other) {
+		m_storage = other.m_storage;
+		m_data = other.m_data;
+		m_size = other.m_size;
+	}
+	return *this;
+}
+
+SharedBuffer& SharedBuffer::operator=(SharedBuffer&& other) noexcept {
+	if (this != &other) {
+		m_storage = std::move(other.m_storage);
+		m_data = other.m_data;
+		m_size = other.m_size;
+		other.m_data = nullptr;
+		other.m_size = 0;
+	}
+	return *this;
+}
+
+const std::uint8_t& SharedBuffer::operator[](std::size_t i) const {
+	return m_data[i];
+}
+
+SharedBuffer SharedBuffer::slice(std::size_t offset, std::size_t length) const {
+	SharedBuffer result(*this);
+	if (offset >= m_size) {
+		result.m_data = nullptr;
+		result.m_size = 0;
+		result.m_storage.reset();
+	}
+	else {
+		result.m_data = m_data + offset;
+		result.m_size = std::min(length, m_size - offset);
+	}
+	return result;
+}
+
+ByteBufferView SharedBuffer::view() const {
+	return ByteBufferView(m_data, m_size);
+}
+
+ByteBuffer SharedBuffer::toMutable() {
+	ByteBuffer result;
+	if (isUnique() && m_data == m_storage->data() && m_size == m_storage->size()) {
+		result = std::move(*m_storage);
+	}
+	else {
+		result = ByteBuffer(m_data, m_size);
+	}
+	m_storage.reset();
+	m_data = nullptr;
+	m_size = 0;
+	return result;
+}
+
+bool SharedBuffer::isUnique() const {
+	return m_storage && m_storage.use_count() == 1;
+}
+
+std::size_t SharedBuffer::size() const {
+	return m_size;
+}
+
+bool SharedBuffer::empty() const {
+	return m_size == 0;
+}
+
+const std::uint8_t* SharedBuffer::data() const {
+	return m_data;
+}
+
+}
@@ -0,0 +1,184 @@
+/*
+ * This file is part of Usbpp, a C++ wrapper around libusb
+ * Copyright (C) 2016  Lukas Jirkovsky <l.jirkovsky @at@ gmail.com>
+ *
+ * Usbpp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, version 3 of the License
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "streamreader.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+
+#include "deviceimpl.h"
+#include "transferpipeline.h"
+
+namespace {
+
+// the number of failed transfers in a row after which the reader gives up
+const unsigned int MaxConsecutiveErrors = 8;
+
+}
+
+namespace Usbpp {
+
+class StreamReader::Impl {
+public:
+	Impl(const Device& device, unsigned char endpoint, StreamSink& sink, std::size_t transferSize, unsigned int depth, bool interrupt);
+
+	/**
+	 * Point the transfer to a buffer of the sink or to the spare buffer when the sink is full
+	 */
+	bool prepareTransfer(libusb_transfer* transfer, ByteBuffer& spare);
+	/**
+	 * Pass the data of a finished transfer to the sink
+	 */
+	bool handleTransfer(libusb_transfer* transfer);
+
+	// keeps the device handle open
+	Device m_device;
+	StreamSink& m_sink;
+	std::size_t m_maxTransferSize;
+	std::atomic<std::size_t> m_transferSize;
+	std::atomic<std::uint64_t> m_bytesReceived;
+	std::atomic<std::uint64_t> m_errors;
+	std::atomic<int> m_lastError;
+	// the completions are serialized by the libusb event handling
+	unsigned int m_consecutiveErrors;
+	TransferPipeline m_pipeline;
+};
+
+StreamReader::Impl::Impl(const Device& device, unsigned char endpoint, StreamSink& sink, std::size_t transferSize, unsigned int depth, bool interrupt) :
+	m_device(device),
+	m_sink(sink),
+	m_maxTransferSize(transferSize),
+	m_transferSize(transferSize),
+	m_bytesReceived(0),
+	m_errors(0),
+	m_lastError(0),
+	m_consecutiveErrors(0),
+	m_pipeline(device.pimpl->m_handle,
+	           interrupt ? LIBUSB_TRANSFER_TYPE_INTERRUPT : LIBUSB_TRANSFER_TYPE_BULK,
+	           endpoint, transferSize, depth, 0,
+	           [this](libusb_transfer* transfer) {
+		return handleTransfer(transfer);
+	},
+	           [this](libusb_transfer* transfer, ByteBuffer& spare) {
+		return prepareTransfer(transfer, spare);
+	}) {
+
+}
+
+bool StreamReader::Impl::prepareTransfer(libusb_transfer* transfer, ByteBuffer& spare) {
+	std::size_t size(m_transferSize);
+	std::uint8_t* buffer(m_sink.claim(size));
+	if (buffer == nullptr) {
+		buffer = spare.data();
+		size = std::min<std::size_t>(m_transferSize, spare.size());
+	}
+	transfer->buffer = buffer;
+	transfer->length = size;
+	return true;
+}
+
+bool StreamReader::Impl::handleTransfer(libusb_transfer* transfer) {
+	m_bytesReceived += transfer->actual_length;
+	if (m_pipeline.isOwnBuffer(transfer)) {
+		if (transfer->actual_length > 0) {
+			m_sink.drop(transfer->actual_length);
+		}
+	}
+	else {
+		m_sink.commit(transfer->actual_length);
+	}
+
+	switch (transfer->status) {
+		case LIBUSB_TRANSFER_COMPLETED:
+			m_consecutiveErrors = 0;
+			return true;
+		case LIBUSB_TRANSFER_TIMED_OUT:
+			return true;
+		case LIBUSB_TRANSFER_CANCELLED:
+			return false;
+		case LIBUSB_TRANSFER_NO_DEVICE:
+		case LIBUSB_TRANSFER_STALL:
+			// the halt can be cleared only synchronously, leave it to the user
+			m_lastError = getTransferError(transfer->status);
+			++m_errors;
+			return false;
+		default:
+			// don't spin on an endpoint that keeps failing
+			m_lastError = getTransferError(transfer->status);
+			++m_errors;
+			return ++m_consecutiveErrors < MaxConsecutiveErrors;
+	}
+}
+
+StreamReader::StreamReader(const Device& device,
+                           unsigned char endpoint,
+                           StreamSink& sink,
+                           std::size_t transferSize,
+                           unsigned int depth,
+                           bool interrupt) :
+	pimpl(new Impl(device, endpoint, sink, transferSize, std::max(depth, 1u), interrupt)) {
+
+	assert(endpoint & LIBUSB_ENDPOINT_IN);
+}
+
+StreamReader::~StreamReader() {
+	stop();
+}
+
+void StreamReader::start() {
+	pimpl->m_consecutiveErrors = 0;
+	pimpl->m_pipeline.start();
+}
+
+void StreamReader::stop() {
+	pimpl->m_pipeline.stop();
+}
+
+bool StreamReader::isRunning() const {
+	return pimpl->m_pipeline.getInFlight() != 0;
+}
+
+void StreamReader::setTransferSize(std::size_t size) {
+	pimpl->m_transferSize = std::min(std::max<std::size_t>(size, 1), pimpl->m_maxTransferSize);
+}
+
+std::size_t StreamReader::getTransferSize() const {
+	return pimpl->m_transferSize;
+}
+
+void StreamReader::setQueueDepth(unsigned int depth) {
+	pimpl->m_pipeline.setDepth(depth);
+}
+
+unsigned int StreamReader::getQueueDepth() const {
+	return pimpl->m_pipeline.getDepth();
+}
+
+std::uint64_t StreamReader::getBytesReceived() const {
+	return pimpl->m_bytesReceived;
+}
+
+std::uint64_t StreamReader::getErrorCount() const {
+	return pimpl->m_errors;
+}
+
+int StreamReader::getLastError() const {
+	return pimpl->m_lastError;
+}
+
+}
@@ -0,0 +1,118 @@
+/*
+ * This file is part of Usbpp, a C++ wrapper around libusb
+ * Copyright (C) 2016  Lukas Jirkovsky <l.jirkovsky @at@ gmail.com>
+ *
+ * Usbpp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, version 3 of the License
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "streamring.h"
+
+namespace Usbpp {
+
+StreamRing::StreamRing(std::size_t slots, std::size_t slotSize) :
+	m_head(0),
+	m_claimed(0),
+	m_cachedTail(0),
+	m_committedBytes(0),
+	m_dropped(0),
+	m_droppedBytes(0),
+	m_overruns(0),
+	m_tail(0),
+	m_cachedHead(0) {
+
+	std::size_t capacity(1);
+	while (capacity < slots) {
+		capacity <<= 1;
+	}
+	m_mask = capacity - 1;
+	m_slots.reserve(capacity);
+	for (std::size_t i = 0; i < capacity; ++i) {
+		m_slots.push_back(ByteBuffer(slotSize));
+	}
+	m_lengths.resize(capacity, 0);
+}
+
+StreamRing::~StreamRing() {
+
+}
+
+std::uint8_t* StreamRing::claim(std::size_t& size) {
+	if (m_claimed - m_cachedTail == m_slots.size()) {
+		// the cached tail is stale, check where the consumer really is
+		m_cachedTail = m_tail.load(std::memory_order_acquire);
+		if (m_claimed - m_cachedTail == m_slots.size()) {
+			m_overruns.store(m_overruns.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+			return nullptr;
+		}
+	}
+	ByteBuffer& slot(m_slots[m_claimed++ & m_mask]);
+	if (size == 0 || size > slot.size()) {
+		size = slot.size();
+	}
+	return slot.data();
+}
+
+void StreamRing::commit(std::size_t length) {
+	std::size_t head(m_head.load(std::memory_order_relaxed));
+	m_lengths[head & m_mask] = length;
+	m_committedBytes.store(m_committedBytes.load(std::memory_order_relaxed) + length, std::memory_order_relaxed);
+	m_head.store(head + 1, std::memory_order_release);
+}
+
+void StreamRing::drop(std::size_t length) {
+	m_dropped.store(m_dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	m_droppedBytes.store(m_droppedBytes.load(std::memory_order_relaxed) + length, std::memory_order_relaxed);
+}
+
+const ByteBuffer* StreamRing::front() const {
+	std::size_t tail(m_tail.load(std::memory_order_relaxed));
+	if (tail == m_cachedHead) {
+		m_cachedHead = m_head.load(std::memory_order_acquire);
+		if (tail == m_cachedHead) {
+			return nullptr;
+		}
+	}
+	return &m_slots[tail & m_mask];
+}
+
+std::size_t StreamRing::frontLength() const {
+	return m_lengths[m_tail.load(std::memory_order_relaxed) & m_mask];
+}
+
+void StreamRing::pop() {
+	m_tail.store(m_tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+std::size_t StreamRing::size() const {
+	return m_head.load(std::memory_order_acquire) - m_tail.load(std::memory_order_acquire);
+}
+
+std::size_t StreamRing::capacity() const {
+	return m_slots.size();
+}
+
+std::size_t StreamRing::getSlotSize() const {
+	return m_slots[0].size();
+}
+
+StreamRingStatistics StreamRing::getStatistics() const {
+	StreamRingStatistics stats;
+	stats.committed = m_head.load(std::memory_order_relaxed);
+	stats.committedBytes = m_committedBytes.load(std::memory_order_relaxed);
+	stats.dropped = m_dropped.load(std::memory_order_relaxed);
+	stats.droppedBytes = m_droppedBytes.load(std::memory_order_relaxed);
+	stats.overruns = m_overruns.load(std::memory_order_relaxed);
+	return stats;
+}
+
+}
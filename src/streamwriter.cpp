@@ -0,0 +1,152 @@
+/*
+ * This file is part of Usbpp, a C++ wrapper around libusb
+ * Copyright (C) 2016  Lukas Jirkovsky <l.jirkovsky @at@ gmail.com>
+ *
+ * Usbpp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, version 3 of the License
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "streamwriter.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+
+#include "deviceimpl.h"
+#include "transferpipeline.h"
+
+namespace Usbpp {
+
+class StreamWriter::Impl {
+public:
+	Impl(const Device& device, unsigned char endpoint, StreamSource& source, unsigned int depth, unsigned int timeout, bool interrupt);
+
+	/**
+	 * Point the transfer to the next block of the source
+	 */
+	bool prepareTransfer(libusb_transfer* transfer);
+	/**
+	 * Release the block of a finished transfer
+	 */
+	bool handleTransfer(libusb_transfer* transfer);
+
+	// keeps the device handle open
+	Device m_device;
+	StreamSource& m_source;
+	std::atomic<std::size_t> m_transferSize;
+	std::atomic<std::uint64_t> m_bytesSent;
+	std::atomic<int> m_error;
+	TransferPipeline m_pipeline;
+};
+
+StreamWriter::Impl::Impl(const Device& device, unsigned char endpoint, StreamSource& source, unsigned int depth, unsigned int timeout, bool interrupt) :
+	m_device(device),
+	m_source(source),
+	m_transferSize(0),
+	m_bytesSent(0),
+	m_error(0),
+	m_pipeline(device.pimpl->m_handle,
+	           interrupt ? LIBUSB_TRANSFER_TYPE_INTERRUPT : LIBUSB_TRANSFER_TYPE_BULK,
+	           endpoint, 0, depth, timeout,
+	           [this](libusb_transfer* transfer) {
+		return handleTransfer(transfer);
+	},
+	           [this](libusb_transfer* transfer, ByteBuffer&) {
+		return prepareTransfer(transfer);
+	}) {
+
+}
+
+bool StreamWriter::Impl::prepareTransfer(libusb_transfer* transfer) {
+	if (m_error != 0) {
+		return false;
+	}
+	std::size_t size(m_transferSize);
+	const std::uint8_t* data(m_source.next(size));
+	if (data == nullptr) {
+		return false;
+	}
+	// libusb does not modify the data of the OUT transfers
+	transfer->buffer = const_cast<std::uint8_t*>(data);
+	transfer->length = size;
+	return true;
+}
+
+bool StreamWriter::Impl::handleTransfer(libusb_transfer* transfer) {
+	m_source.release(transfer->actual_length);
+	m_bytesSent += transfer->actual_length;
+	if (transfer->status != LIBUSB_TRANSFER_COMPLETED) {
+		if (m_error == 0) {
+			m_error = getTransferError(transfer->status);
+		}
+		return false;
+	}
+	return true;
+}
+
+StreamWriter::StreamWriter(const Device& device,
+                           unsigned char endpoint,
+                           StreamSource& source,
+                           unsigned int depth,
+                           unsigned int timeout,
+                           bool interrupt) :
+	pimpl(new Impl(device, endpoint, source, std::max(depth, 1u), timeout, interrupt)) {
+
+	assert((endpoint & LIBUSB_ENDPOINT_IN) == 0);
+}
+
+StreamWriter::~StreamWriter() {
+	stop();
+}
+
+void StreamWriter::start() {
+	pimpl->m_error = 0;
+	pimpl->m_pipeline.start();
+}
+
+void StreamWriter::wait() {
+	pimpl->m_pipeline.wait();
+	int error(pimpl->m_error);
+	if (error != 0) {
+		throw DeviceTransferException(error);
+	}
+}
+
+void StreamWriter::stop() {
+	pimpl->m_pipeline.stop();
+}
+
+bool StreamWriter::isRunning() const {
+	return pimpl->m_pipeline.getInFlight() != 0;
+}
+
+void StreamWriter::setTransferSize(std::size_t size) {
+	pimpl->m_transferSize = size;
+}
+
+std::size_t StreamWriter::getTransferSize() const {
+	return pimpl->m_transferSize;
+}
+
+void StreamWriter::setQueueDepth(unsigned int depth) {
+	pimpl->m_pipeline.setDepth(depth);
+}
+
+unsigned int StreamWriter::getQueueDepth() const {
+	return pimpl->m_pipeline.getDepth();
+}
+
+std::uint64_t StreamWriter::getBytesSent() const {
+	return pimpl->m_bytesSent;
+}
+
+}
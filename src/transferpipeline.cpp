@@ -0,0 +1,191 @@
+/*
+ * This file is part of Usbpp, a C++ wrapper around libusb
+ * Copyright (C) 2016  Lukas Jirkovsky <l.jirkovsky @at@ gmail.com>
+ *
+ * Usbpp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, version 3 of the License
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "transferpipeline.h"
+
+#include <algorithm>
+
+#include "device.h"
+#include "latencyrecorder.h"
+
+namespace Usbpp {
+
+TransferPipeline::TransferPipeline(libusb_device_handle* handle,
+                                   unsigned char type,
+                                   unsigned char endpoint,
+                                   std::size_t transferSize,
+                                   unsigned int depth,
+                                   unsigned int timeout,
+                                   const CompletionHandler& handler,
+                                   const PrepareHandler& prepare) :
+	m_handler(handler),
+	m_prepare(prepare),
+	m_busy(depth, false),
+	m_inFlight(0),
+	m_depth(depth),
+	m_stopping(false) {
+
+	m_buffers.reserve(depth);
+	m_transfers.reserve(depth);
+	for (unsigned int i = 0; i < depth; ++i) {
+		m_buffers.push_back(ByteBuffer(transferSize));
+		libusb_transfer* transfer(libusb_alloc_transfer(0));
+		if (transfer == nullptr) {
+			for (libusb_transfer* allocated : m_transfers) {
+				libusb_free_transfer(allocated);
+			}
+			throw DeviceTransferException(LIBUSB_ERROR_NO_MEM);
+		}
+		if (type == LIBUSB_TRANSFER_TYPE_INTERRUPT) {
+			libusb_fill_interrupt_transfer(transfer, handle, endpoint, m_buffers[i].data(), transferSize, transferCallback, this, timeout);
+		}
+		else {
+			libusb_fill_bulk_transfer(transfer, handle, endpoint, m_buffers[i].data(), transferSize, transferCallback, this, timeout);
+		}
+		m_transfers.push_back(transfer);
+	}
+}
+
+TransferPipeline::~TransferPipeline() {
+	stop();
+	for (libusb_transfer* transfer : m_transfers) {
+		libusb_free_transfer(transfer);
+	}
+}
+
+void TransferPipeline::start() {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (m_inFlight != 0) {
+		return;
+	}
+
+	m_stopping = false;
+	int error(LIBUSB_SUCCESS);
+	for (std::size_t i = 0; i < m_transfers.size() && m_inFlight < m_depth; ++i) {
+		int res(submit(i));
+		if (res == 0) {
+			m_busy[i] = true;
+			++m_inFlight;
+		}
+		else if (res < 0) {
+			error = res;
+		}
+	}
+	if (m_inFlight == 0 && error != LIBUSB_SUCCESS) {
+		throw DeviceTransferException(error);
+	}
+}
+
+void TransferPipeline::stop() {
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (m_inFlight == 0) {
+			return;
+		}
+		m_stopping = true;
+	}
+
+	// transfers that are not submitted at the moment are retired by complete()
+	for (libusb_transfer* transfer : m_transfers) {
+		libusb_cancel_transfer(transfer);
+	}
+
+	wait();
+}
+
+void TransferPipeline::wait() {
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_finished.wait(lock, [this]() {
+		return m_inFlight == 0;
+	});
+}
+
+void TransferPipeline::setDepth(unsigned int depth) {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_depth = std::min(std::max(depth, 1u), static_cast<unsigned int>(m_transfers.size()));
+	if (m_inFlight == 0 || m_stopping) {
+		return;
+	}
+	for (std::size_t i = 0; i < m_transfers.size() && m_inFlight < m_depth; ++i) {
+		if (!m_busy[i] && submit(i) == 0) {
+			m_busy[i] = true;
+			++m_inFlight;
+		}
+	}
+}
+
+unsigned int TransferPipeline::getDepth() const {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_depth;
+}
+
+unsigned int TransferPipeline::getInFlight() const {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_inFlight;
+}
+
+bool TransferPipeline::isOwnBuffer(const libusb_transfer* transfer) const {
+	for (std::size_t i = 0; i < m_transfers.size(); ++i) {
+		if (m_transfers[i] == transfer) {
+			return transfer->buffer == m_buffers[i].data();
+		}
+	}
+	return false;
+}
+
+void LIBUSB_CALL TransferPipeline::transferCallback(libusb_transfer* transfer) {
+	static_cast<TransferPipeline*>(transfer->user_data)->complete(transfer);
+}
+
+void TransferPipeline::complete(libusb_transfer* transfer) {
+	LatencyRecorder* recorder(LatencyRecorder::current());
+	if (recorder != nullptr) {
+		recorder->record();
+	}
+
+	bool resubmit(m_handler(transfer));
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	std::size_t index(std::find(m_transfers.begin(), m_transfers.end(), transfer) - m_transfers.begin());
+	// the finished transfer still counts as in flight, keep it only if within the limit
+	if (resubmit && !m_stopping && m_inFlight <= m_depth) {
+		if (submit(index) == 0) {
+			return;
+		}
+	}
+	m_busy[index] = false;
+	--m_inFlight;
+	// notify while holding the lock, the pipeline may be destroyed right after it is released
+	m_finished.notify_all();
+}
+
+int TransferPipeline::submit(std::size_t index) {
+	libusb_transfer* transfer(m_transfers[index]);
+	if (m_prepare && !m_prepare(transfer, m_buffers[index])) {
+		return 1;
+	}
+	int res(libusb_submit_transfer(transfer));
+	if (res != 0 && m_prepare) {
+		// let the handler release whatever the prepare function acquired
+		transfer->status = LIBUSB_TRANSFER_ERROR;
+		transfer->actual_length = 0;
+		m_handler(transfer);
+	}
+	return res;
+}
+
+}
@@ -0,0 +1,155 @@
+/*
+ * This file is part of Usbpp, a C++ wrapper around libusb
+ * Copyright (C) 2016  Lukas Jirkovsky <l.jirkovsky @at@ gmail.com>
+ *
+ * Usbpp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, version 3 of the License
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBUSBPP_TRANSFERPIPELINE_H_
+#define LIBUSBPP_TRANSFERPIPELINE_H_
+
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+#include <libusb.h>
+
+#include "buffer.h"
+
+namespace Usbpp {
+
+/**
+ * Keeps a number of transfers on one endpoint submitted at all times.
+ *
+ * The transfers and their buffers are allocated once and resubmitted
+ * directly from the completion callback, so there is no gap between two
+ * transfers as long as at least one of them is submitted.
+ */
+class TransferPipeline {
+public:
+	/**
+	 * Function called for each finished transfer.
+	 *
+	 * The function is called from the event loop. The buffer of the transfer
+	 * is valid only during the call.
+	 *
+	 * \return true to resubmit the transfer, false to retire it
+	 */
+	typedef std::function<bool(libusb_transfer* transfer)> CompletionHandler;
+	/**
+	 * Function called before each submission of a transfer.
+	 *
+	 * The function may point the transfer to a different buffer (and change
+	 * its length). \a own is the buffer allocated by the pipeline for the transfer.
+	 *
+	 * \return true to submit the transfer, false to retire it
+	 */
+	typedef std::function<bool(libusb_transfer* transfer, ByteBuffer& own)> PrepareHandler;
+
+	/**
+	 * \param handle handle of the open device
+	 * \param type libusb_transfer_type of the transfers (bulk or interrupt)
+	 * \param endpoint address of the endpoint
+	 * \param transferSize size of the buffer of each transfer
+	 * \param depth maximum number of transfers kept submitted
+	 * \param timeout timeout of each transfer in milliseconds, 0 for unlimited
+	 * \param handler function called for each finished transfer
+	 * \param prepare function called before each submission, may be empty
+	 */
+	TransferPipeline(libusb_device_handle* handle,
+	                 unsigned char type,
+	                 unsigned char endpoint,
+	                 std::size_t transferSize,
+	                 unsigned int depth,
+	                 unsigned int timeout,
+	                 const CompletionHandler& handler,
+	                 const PrepareHandler& prepare = nullptr);
+	TransferPipeline(const TransferPipeline& other) = delete;
+	~TransferPipeline();
+
+	TransferPipeline& operator=(const TransferPipeline& other) = delete;
+
+	/**
+	 * Submit all transfers.
+	 *
+	 * \throws DeviceTransferException if none of the transfers can be submitted
+	 */
+	void start();
+	/**
+	 * Cancel all submitted transfers and wait until they are finished.
+	 *
+	 * Must not be called from the completion handler.
+	 */
+	void stop();
+	/**
+	 * Get the number of transfers that are currently submitted.
+	 */
+	unsigned int getInFlight() const;
+	/**
+	 * Wait until all transfers are retired.
+	 *
+	 * Must not be called from the completion handler.
+	 */
+	void wait();
+	/**
+	 * Limit the number of transfers kept submitted.
+	 *
+	 * When the limit is raised while the pipeline is running, the idle transfers
+	 * are submitted right away. When it is lowered, the transfers above the
+	 * limit are retired as they finish.
+	 *
+	 * \param depth the limit, between 1 and the depth given to the constructor
+	 */
+	void setDepth(unsigned int depth);
+	/**
+	 * Get the limit of the transfers kept submitted.
+	 */
+	unsigned int getDepth() const;
+	/**
+	 * Check whether the transfer uses the buffer allocated by the pipeline.
+	 */
+	bool isOwnBuffer(const libusb_transfer* transfer) const;
+
+private:
+	static void LIBUSB_CALL transferCallback(libusb_transfer* transfer);
+	void complete(libusb_transfer* transfer);
+	/**
+	 * Prepare and submit a transfer, the lock must be held
+	 *
+	 * If the submission fails, the completion handler is called with the
+	 * transfer marked as failed.
+	 *
+	 * \return 0 if the transfer was submitted, 1 if the prepare function
+	 *         retired it or the libusb error
+	 */
+	int submit(std::size_t index);
+
+
+	CompletionHandler m_handler;
+	PrepareHandler m_prepare;
+	std::vector<libusb_transfer*> m_transfers;
+	std::vector<ByteBuffer> m_buffers;
+	mutable std::mutex m_mutex;
+	std::condition_variable m_finished;
+	// transfers that are submitted or being completed
+	std::vector<bool> m_busy;
+	unsigned int m_inFlight;
+	unsigned int m_depth;
+	bool m_stopping;
+};
+
+}
+
+#endif